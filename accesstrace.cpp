@@ -0,0 +1,94 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <fstream>
+
+#include "accesstrace.h"
+#include "pakexception.h"
+
+AccessTrace::AccessTrace()
+{
+
+}
+
+void AccessTrace::load(const char *traceFile)
+{
+    std::ifstream fin(traceFile);
+    if (!fin) {
+        throw PakException("Could not open file", traceFile);
+    }
+    std::string line;
+    while (std::getline(fin, line)) {
+        std::string_view path(line);
+        if (path.compare(0, 10, "PackFile: ") == 0) { // Engine developer log.
+            auto separator = path.find(" : ");
+            if (separator == std::string_view::npos) {
+                continue;
+            }
+            path.remove_prefix(separator + 3);
+        }
+        while (!path.empty() && (path.back() == '\r' || path.back() == ' ')) {
+            path.remove_suffix(1);
+        }
+        if (!path.empty() && path.front() == '#') {
+            continue;
+        }
+        record(path);
+    }
+}
+
+void AccessTrace::append(const char *traceFile) const
+{
+    std::ofstream fout;
+    fout.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    try {
+        fout.open(traceFile, std::ios_base::out | std::ios_base::app);
+        for (const auto &x : m_paths) {
+            fout << x << '\n';
+        }
+        fout.close();
+    } catch (std::ofstream::failure &e) {
+        throw PakException("Error writing file", traceFile);
+    }
+}
+
+void AccessTrace::record(std::string_view path)
+{
+    while (!path.empty() && path.front() == '/') {
+        path.remove_prefix(1);
+    }
+    if (path.empty()) {
+        return;
+    }
+    std::string entry(path);
+    if (seen.insert(entry).second) {
+        m_paths.push_back(std::move(entry));
+    }
+}
+
+const stringList &AccessTrace::paths() const
+{
+    return m_paths;
+}
+
+size_t AccessTrace::size() const
+{
+    return m_paths.size();
+}
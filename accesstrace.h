@@ -0,0 +1,50 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef ACCESSTRACE_H
+#define ACCESSTRACE_H
+
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "func.h"
+
+// The order entries of a PAK file are read in, one path per line.  Traces
+// are recorded by pak itself when writing or exporting entries, or taken
+// from a Quake engine's developer log, where each file opened from a PAK
+// is printed as "PackFile: pak0.pak : maps/e1m1.bsp".  Repacking in trace
+// order places the entries read together at level load next to each other.
+class AccessTrace
+{
+public:
+    AccessTrace();
+
+    void load(const char *traceFile); // Only the first read of each path is kept.
+    void append(const char *traceFile) const; // Add the paths recorded in this run to a trace file.
+    void record(std::string_view path);
+    const stringList &paths() const;
+    size_t size() const;
+private:
+    stringList m_paths;
+    std::unordered_set<std::string> seen;
+};
+
+#endif // ACCESSTRACE_H
@@ -0,0 +1,186 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "buildcache.h"
+#include "pakexception.h"
+
+BuildCache::BuildCache() :
+    m_rebuild(false), m_reusedFiles(0), m_reusedBytes(0), m_readFiles(0), m_readBytes(0)
+{
+
+}
+
+BuildCache::FileState BuildCache::stateOf(const struct stat &statbuf)
+{
+    FileState state;
+    state.size = statbuf.st_size;
+#ifdef __linux
+    state.mtime = static_cast<int64_t>(statbuf.st_mtim.tv_sec) * 1000000000 + statbuf.st_mtim.tv_nsec;
+#elif __APPLE__
+    state.mtime = static_cast<int64_t>(statbuf.st_mtimespec.tv_sec) * 1000000000 + statbuf.st_mtimespec.tv_nsec;
+#else
+    state.mtime = static_cast<int64_t>(statbuf.st_mtime) * 1000000000;
+#endif
+    state.inode = statbuf.st_ino;
+    state.seen = true;
+    return state;
+}
+
+static std::string absolutePath(const std::string &directory)
+{
+#ifdef __WIN32
+    char *resolved = _fullpath(nullptr, directory.c_str(), 0);
+#else
+    char *resolved = realpath(directory.c_str(), nullptr);
+#endif
+    if (resolved == nullptr) {
+        throw PakException("Could not open directory", directory.c_str());
+    }
+    std::string path = resolved;
+    free(resolved);
+    return path;
+}
+
+void BuildCache::load(const char *cacheFile)
+{
+    std::ifstream fin(cacheFile);
+    std::string line;
+
+    files.clear();
+    while (std::getline(fin, line)) {
+        std::istringstream fields(line);
+        FileState state;
+        std::string path;
+        if (!(fields >> state.size >> state.mtime >> state.inode) || fields.get() != '\t' ||
+            !std::getline(fields, state.root, '\t') || !std::getline(fields, state.source, '\t') ||
+            !std::getline(fields, path)) {
+            files.clear(); // Don't trust a damaged cache at all.
+            return;
+        }
+        state.seen = false;
+        files[path] = state;
+    }
+}
+
+void BuildCache::save(const char *cacheFile)
+{
+    std::ofstream fout;
+    fout.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    try {
+        fout.open(cacheFile, std::ios_base::out | std::ios_base::trunc);
+        for (const auto &x : files) {
+            fout << x.second.size << ' ' << x.second.mtime << ' ' << x.second.inode << '\t'
+                 << x.second.root << '\t' << x.second.source << '\t' << x.first << '\n';
+        }
+        fout.close();
+    } catch (std::ofstream::failure &e) {
+        throw PakException("Error writing file", cacheFile);
+    }
+}
+
+void BuildCache::setRebuild(bool rebuild)
+{
+    m_rebuild = rebuild;
+}
+
+void BuildCache::setSource(const std::string &directory, const std::string &prefix)
+{
+    m_root = absolutePath(directory);
+    m_prefix = prefix;
+}
+
+bool BuildCache::imported(const std::string &path) const
+{
+    auto found = files.find(path);
+    return found != files.end() && found->second.root == m_root;
+}
+
+bool BuildCache::unchanged(const std::string &path, const struct stat &statbuf) const
+{
+    if (m_rebuild) {
+        return false;
+    }
+    auto found = files.find(path);
+    if (found == files.end() || found->second.root != m_root) {
+        return false;
+    }
+    auto now = stateOf(statbuf);
+    return found->second.size == now.size && found->second.mtime == now.mtime && found->second.inode == now.inode;
+}
+
+void BuildCache::update(const std::string &path, const struct stat &statbuf)
+{
+    auto state = stateOf(statbuf);
+    state.root = m_root;
+    state.source = path.compare(0, m_prefix.size(), m_prefix) == 0 ? path.substr(m_prefix.size()) : path;
+    files[path] = state;
+}
+
+void BuildCache::remove(const std::string &path)
+{
+    files.erase(path);
+}
+
+stringList BuildCache::stale(const std::string &prefix) const
+{
+    stringList paths;
+    for (auto x = files.lower_bound(prefix); x != files.end() && x->first.compare(0, prefix.size(), prefix) == 0; ++x) {
+        if (!x->second.seen && x->second.root == m_root && !fexists(m_root + "/" + x->second.source)) {
+            paths.push_back(x->first);
+        }
+    }
+    return paths;
+}
+
+void BuildCache::countReused(int64_t bytes)
+{
+    ++m_reusedFiles;
+    m_reusedBytes += bytes;
+}
+
+void BuildCache::countRead(int64_t bytes)
+{
+    ++m_readFiles;
+    m_readBytes += bytes;
+}
+
+size_t BuildCache::reusedFiles() const
+{
+    return m_reusedFiles;
+}
+
+int64_t BuildCache::reusedBytes() const
+{
+    return m_reusedBytes;
+}
+
+size_t BuildCache::readFiles() const
+{
+    return m_readFiles;
+}
+
+int64_t BuildCache::readBytes() const
+{
+    return m_readBytes;
+}
@@ -0,0 +1,83 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef BUILDCACHE_H
+#define BUILDCACHE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "func.h"
+
+// Remembers the size, modification time and inode of every file imported
+// from disk, keyed by its path in the PAK file, with the directory it was
+// imported from.  When a later import of the same directory finds a file
+// unchanged, its data can be copied from the existing PAK file rather than
+// read again.  Entries imported from other directories are never touched.
+// Kept in a file next to the PAK file.
+class BuildCache
+{
+public:
+    BuildCache();
+
+    void load(const char *cacheFile); // A missing file gives an empty cache.
+    void save(const char *cacheFile);
+    void setRebuild(bool rebuild); // Treat every file as changed.
+    // The directory being imported and the path in the PAK file it is
+    // imported to.  Only files from this directory are reused or removed.
+    void setSource(const std::string &directory, const std::string &prefix);
+    bool imported(const std::string &path) const; // Imported from this directory before.
+    bool unchanged(const std::string &path, const struct stat &statbuf) const;
+    void update(const std::string &path, const struct stat &statbuf); // Record a file as imported in this run.
+    void remove(const std::string &path);
+    stringList stale(const std::string &prefix) const; // Paths under prefix whose files have been deleted.
+
+    void countReused(int64_t bytes);
+    void countRead(int64_t bytes);
+    size_t reusedFiles() const;
+    int64_t reusedBytes() const;
+    size_t readFiles() const;
+    int64_t readBytes() const;
+private:
+    struct FileState
+    {
+        int64_t size;
+        int64_t mtime; // Nanoseconds
+        uint64_t inode;
+        std::string root; // Absolute path of the directory imported.
+        std::string source; // Path of the file within root.
+        bool seen;
+    };
+    std::map<std::string, FileState> files;
+    std::string m_root;
+    std::string m_prefix;
+    bool m_rebuild;
+    size_t m_reusedFiles;
+    int64_t m_reusedBytes;
+    size_t m_readFiles;
+    int64_t m_readBytes;
+
+    static FileState stateOf(const struct stat &statbuf);
+};
+
+#endif // BUILDCACHE_H
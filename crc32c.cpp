@@ -0,0 +1,183 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <array>
+#include <cstring>
+
+#include "crc32c.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32C_X86
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC32C_ARM
+#include <arm_acle.h>
+#endif
+
+static const uint32_t CRC32C_POLY = 0x82f63b78; // Reflected Castagnoli polynomial.
+
+static std::array<uint32_t, 256> makeTable()
+{
+    std::array<uint32_t, 256> table;
+    for (uint32_t x = 0; x < 256; ++x) {
+        uint32_t crc = x;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        table[x] = crc;
+    }
+    return table;
+}
+
+static uint32_t crc32cSoftware(uint32_t crc, const unsigned char *data, size_t length)
+{
+    static const std::array<uint32_t, 256> table = makeTable();
+    while (length--) {
+        crc = table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(uint32_t crc, const unsigned char *data, size_t length)
+{
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    while (length >= sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += sizeof(word);
+        length -= sizeof(word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+#endif
+    while (length >= sizeof(uint32_t)) {
+        uint32_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+        data += sizeof(word);
+        length -= sizeof(word);
+    }
+    while (length--) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+
+static bool hasHardwareCrc()
+{
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+}
+#elif defined(CRC32C_ARM)
+static uint32_t crc32cHardware(uint32_t crc, const unsigned char *data, size_t length)
+{
+    while (length >= sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = __crc32cd(crc, word);
+        data += sizeof(word);
+        length -= sizeof(word);
+    }
+    while (length--) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return crc;
+}
+
+static bool hasHardwareCrc()
+{
+    return true; // Guaranteed by __ARM_FEATURE_CRC32.
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const char *data, size_t length)
+{
+    auto bytes = reinterpret_cast<const unsigned char *>(data);
+    crc = ~crc;
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+    if (hasHardwareCrc()) {
+        return ~crc32cHardware(crc, bytes, length);
+    }
+#endif
+    return ~crc32cSoftware(crc, bytes, length);
+}
+
+
+// Combining works by multiplying the first checksum by x^(8 * lengthB) in
+// GF(2), done with repeated squaring of the CRC shift operator, as in zlib.
+static uint32_t gf2MatrixTimes(const uint32_t *matrix, uint32_t vector)
+{
+    uint32_t sum = 0;
+    while (vector) {
+        if (vector & 1) {
+            sum ^= *matrix;
+        }
+        vector >>= 1;
+        matrix++;
+    }
+    return sum;
+}
+
+static void gf2MatrixSquare(uint32_t *square, const uint32_t *matrix)
+{
+    for (int n = 0; n < 32; n++) {
+        square[n] = gf2MatrixTimes(matrix, matrix[n]);
+    }
+}
+
+uint32_t crc32cCombine(uint32_t crcA, uint32_t crcB, size_t lengthB)
+{
+    uint32_t even[32];
+    uint32_t odd[32];
+
+    if (lengthB == 0) {
+        return crcA;
+    }
+
+    odd[0] = CRC32C_POLY; // Operator for one zero bit.
+    uint32_t row = 1;
+    for (int n = 1; n < 32; n++) {
+        odd[n] = row;
+        row <<= 1;
+    }
+    gf2MatrixSquare(even, odd); // Two zero bits.
+    gf2MatrixSquare(odd, even); // Four zero bits.
+
+    do {
+        gf2MatrixSquare(even, odd);
+        if (lengthB & 1) {
+            crcA = gf2MatrixTimes(even, crcA);
+        }
+        lengthB >>= 1;
+        if (lengthB == 0) {
+            break;
+        }
+        gf2MatrixSquare(odd, even);
+        if (lengthB & 1) {
+            crcA = gf2MatrixTimes(odd, crcA);
+        }
+        lengthB >>= 1;
+    } while (lengthB != 0);
+
+    return crcA ^ crcB;
+}
@@ -0,0 +1,36 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli), as used by iSCSI and ext4.  Pass the result of a
+// previous call as crc to continue a checksum, or 0 to start a new one.
+// Uses the SSE 4.2 or ARMv8 CRC instructions when the CPU has them.
+uint32_t crc32c(uint32_t crc, const char *data, size_t length);
+
+// Returns the checksum of A followed by B, given the checksums of each
+// and the length of B.  Lets separate parts of an entry be summed in parallel.
+uint32_t crc32cCombine(uint32_t crcA, uint32_t crcB, size_t lengthB);
+
+#endif // CRC32C_H
@@ -21,10 +21,10 @@
 #include "exceptionhandler.h"
 #include "pakexception.h"
 
-void exceptionHander(PakException& e)
+void exceptionHander(PakException& e, std::ostream &out)
 {
-  std::cout << "Error!\n";
-  std::cout << e.what() << "\n" << e.where() << "\n";
+  out << "Error!\n";
+  out << e.what() << "\n" << e.where() << "\n";
   return;
 
 }
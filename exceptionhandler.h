@@ -24,6 +24,6 @@
 #include "pakexception.h"
 #include <iostream>
 
-void exceptionHander(PakException &e);
+void exceptionHander(PakException &e, std::ostream &out = std::cout);
 
 #endif // EXCEPTIONHANDLER_H
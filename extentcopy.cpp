@@ -0,0 +1,343 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+#ifndef __WIN32
+#include <sys/statvfs.h>
+#endif
+#ifdef __APPLE__
+#include <fcntl.h>
+#endif
+
+#ifdef __linux
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+
+#include "extentcopy.h"
+
+static void throwCopyError(const char *what)
+{
+    std::string message = what;
+    message += " : ";
+    message += std::strerror(errno);
+    throw PakException("Error copying data", message.c_str());
+}
+
+void writeAll(int outFd, const char *buffer, size_t length)
+{
+    while (length > 0) {
+        auto written = ::write(outFd, buffer, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throwCopyError("write");
+        }
+        buffer += written;
+        length -= written;
+    }
+}
+
+void readAll(int inFd, char *buffer, size_t length, off_t offset)
+{
+    while (length > 0) {
+        auto got = ::pread(inFd, buffer, length, offset);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throwCopyError("read");
+        }
+        if (got == 0) {
+            throw PakException("Error copying data", "Unexpected end of file.  PAK file is truncated.");
+        }
+        buffer += got;
+        offset += got;
+        length -= got;
+    }
+}
+
+// Plain read/write copy.  Used when neither end supports a zero copy transfer.
+static void bufferedCopy(int inFd, off_t inOffset, int outFd, size_t length)
+{
+    std::unique_ptr<char[]> buffer(new char[COPY_BUFFER_SIZE]);
+
+    while (length > 0) {
+        auto chunk = std::min(length, COPY_BUFFER_SIZE);
+        auto got = ::pread(inFd, buffer.get(), chunk, inOffset);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throwCopyError("read");
+        }
+        if (got == 0) {
+            throw PakException("Error copying data", "Unexpected end of file.  PAK file is truncated.");
+        }
+        writeAll(outFd, buffer.get(), got);
+        inOffset += got;
+        length -= got;
+    }
+}
+
+#ifdef __linux
+// Returns the number of bytes that could not be transferred by the kernel.
+// The remainder is left to the buffered copy.
+static size_t kernelCopy(int inFd, off_t &inOffset, int outFd, size_t length)
+{
+    struct stat statbuf;
+    if (fstat(outFd, &statbuf) != 0) {
+        return length;
+    }
+    const bool toPipe = S_ISFIFO(statbuf.st_mode);
+
+    // Between regular files, copy_file_range lets the filesystem share or
+    // copy the blocks itself.  Try it first and fall back to sendfile.
+    while (S_ISREG(statbuf.st_mode) && length > 0) {
+        loff_t offset = inOffset;
+        auto moved = copy_file_range(inFd, &offset, outFd, nullptr, length, 0);
+        if (moved < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EINVAL || errno == ENOSYS || errno == EXDEV || errno == EOPNOTSUPP ||
+                errno == EBADF) { // EBADF when the output was opened for appending.
+                break;
+            }
+            throwCopyError("copy_file_range");
+        }
+        if (moved == 0) {
+            throw PakException("Error copying data", "Unexpected end of file.  PAK file is truncated.");
+        }
+        inOffset += moved;
+        length -= moved;
+    }
+
+    while (length > 0) {
+        ssize_t moved;
+        if (toPipe) {
+            loff_t offset = inOffset;
+            moved = splice(inFd, &offset, outFd, nullptr, length, SPLICE_F_MOVE);
+        } else {
+            moved = sendfile(outFd, inFd, &inOffset, length);
+            if (moved > 0) {
+                inOffset -= moved; // Advanced by both sendfile and below.
+            }
+        }
+        if (moved < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EINVAL || errno == ENOSYS || errno == EXDEV || errno == EOPNOTSUPP) {
+                return length;
+            }
+            throwCopyError(toPipe ? "splice" : "sendfile");
+        }
+        if (moved == 0) {
+            throw PakException("Error copying data", "Unexpected end of file.  PAK file is truncated.");
+        }
+        inOffset += moved;
+        length -= moved;
+    }
+    return 0;
+}
+#endif
+
+static void plainCopy(int inFd, off_t inOffset, int outFd, size_t length)
+{
+#ifdef __linux
+    length = kernelCopy(inFd, inOffset, outFd, length);
+#endif
+    bufferedCopy(inFd, inOffset, outFd, length);
+}
+
+void copyStream(int inFd, int outFd, size_t length)
+{
+#ifdef __linux
+    // splice() moves data from a pipe without copying it through user space.
+    while (length > 0) {
+        auto moved = splice(inFd, nullptr, outFd, nullptr, length, SPLICE_F_MOVE);
+        if (moved < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EINVAL || errno == ENOSYS) {
+                break;
+            }
+            throwCopyError("splice");
+        }
+        if (moved == 0) {
+            throw PakException("Error copying data", "Unexpected end of input.");
+        }
+        length -= moved;
+    }
+#endif
+    std::unique_ptr<char[]> buffer;
+    if (length > 0) {
+        buffer.reset(new char[COPY_BUFFER_SIZE]);
+    }
+    while (length > 0) {
+        auto got = ::read(inFd, buffer.get(), std::min(length, COPY_BUFFER_SIZE));
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throwCopyError("read");
+        }
+        if (got == 0) {
+            throw PakException("Error copying data", "Unexpected end of input.");
+        }
+        writeAll(outFd, buffer.get(), got);
+        length -= got;
+    }
+}
+
+#if defined(__linux) && defined(FICLONERANGE)
+static dev_t noCloneDevice = 0; // Last filesystem found not to support cloning.
+
+// On copy on write filesystems (btrfs, XFS) whole blocks can be shared with
+// the source instead of copied, but only where the source and destination
+// are aligned the same way within a block.  Copies the unaligned ends
+// normally.  Returns false, having copied nothing, if cloning is not
+// possible.
+static bool cloneExtent(int inFd, off_t inOffset, int outFd, size_t length)
+{
+    struct stat statbuf;
+    if (fstat(outFd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode) || statbuf.st_blksize <= 0 ||
+        statbuf.st_dev == noCloneDevice) {
+        return false;
+    }
+    const off_t block = statbuf.st_blksize;
+    auto outOffset = lseek(outFd, 0, SEEK_CUR);
+    if (outOffset < 0 || inOffset % block != outOffset % block) {
+        return false;
+    }
+    size_t head = (block - outOffset % block) % block;
+    if (length < head + block) {
+        return false;
+    }
+    size_t run = (length - head) / block * block;
+
+    plainCopy(inFd, inOffset, outFd, head);
+    file_clone_range range;
+    range.src_fd = inFd;
+    range.src_offset = inOffset + head;
+    range.src_length = run;
+    range.dest_offset = outOffset + head;
+    if (ioctl(outFd, FICLONERANGE, &range) != 0) {
+        if (errno == EOPNOTSUPP || errno == ENOTTY || errno == EXDEV) {
+            noCloneDevice = statbuf.st_dev;
+        }
+        plainCopy(inFd, inOffset + head, outFd, length - head);
+        return true;
+    }
+    if (lseek(outFd, outOffset + head + run, SEEK_SET) < 0) {
+        throwCopyError("lseek");
+    }
+    plainCopy(inFd, inOffset + head + run, outFd, length - head - run);
+    return true;
+}
+#endif
+
+bool cloneFile(int inFd, int outFd)
+{
+#if defined(__linux) && defined(FICLONE)
+    return ioctl(outFd, FICLONE, inFd) == 0;
+#else
+    return false;
+#endif
+}
+
+void copyExtent(int inFd, off_t inOffset, int outFd, size_t length)
+{
+#if defined(__linux) && defined(FICLONERANGE)
+    if (cloneExtent(inFd, inOffset, outFd, length)) {
+        return;
+    }
+#endif
+    plainCopy(inFd, inOffset, outFd, length);
+}
+
+size_t blockSize(int fd)
+{
+#ifdef __WIN32
+    (void)fd;
+    return 0;
+#else
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0 || statbuf.st_blksize <= 0) {
+        return 0;
+    }
+    return statbuf.st_blksize;
+#endif
+}
+
+int64_t freeSpace(const char *path, size_t &unit)
+{
+    unit = 1;
+#ifdef __WIN32
+    (void)path;
+    return -1;
+#else
+    struct statvfs statbuf;
+    if (statvfs(path, &statbuf) != 0 || statbuf.f_frsize == 0) {
+        return -1;
+    }
+    unit = statbuf.f_frsize;
+    return int64_t(statbuf.f_bavail) * int64_t(statbuf.f_frsize);
+#endif
+}
+
+bool preallocate(int outFd, int64_t length)
+{
+    if (length <= 0) {
+        return true;
+    }
+#ifdef __linux
+    // Unlike posix_fallocate(), this never falls back to writing zeros.
+    if (fallocate(outFd, FALLOC_FL_KEEP_SIZE, 0, length) != 0) {
+        return errno != ENOSPC;
+    }
+    return true;
+#elif __APPLE__
+    fstore_t store = {F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, length, 0};
+    if (fcntl(outFd, F_PREALLOCATE, &store) == -1) {
+        store.fst_flags = F_ALLOCATEALL;
+        if (fcntl(outFd, F_PREALLOCATE, &store) == -1) {
+            return errno != ENOSPC;
+        }
+    }
+    return true;
+#else
+    (void)outFd;
+    return true;
+#endif
+}
@@ -0,0 +1,66 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef EXTENTCOPY_H
+#define EXTENTCOPY_H
+
+#include <cstdint>
+#include <sys/types.h>
+
+#include "pakexception.h"
+
+// Size of the bounce buffer used when no kernel assisted copy is available.
+const size_t COPY_BUFFER_SIZE = 1 << 16;
+
+// Copies length bytes starting at inOffset in inFd to the current position
+// of outFd.  The file position of inFd is not changed.  Where both files
+// are on a copy on write filesystem and aligned alike, whole blocks are
+// shared rather than copied.  Otherwise, when the kernel supports it, the
+// data never passes through user space, or failing that it is copied
+// through a fixed size buffer so memory use does not depend on length.
+void copyExtent(int inFd, off_t inOffset, int outFd, size_t length);
+
+// Writes the whole buffer to outFd, retrying short writes.
+void writeAll(int outFd, const char *buffer, size_t length);
+
+// Reads exactly length bytes at offset in inFd, retrying short reads.
+void readAll(int inFd, char *buffer, size_t length, off_t offset);
+
+// Like copyExtent(), but reads from the current position of inFd, so it
+// also works when inFd is a pipe such as standard input.
+void copyStream(int inFd, int outFd, size_t length);
+
+// Makes outFd share all of the data of inFd, on filesystems that can clone
+// files.  Returns false, having changed nothing, where they cannot.
+bool cloneFile(int inFd, int outFd);
+
+// The filesystem block size of the file, or 0 if it is not known.
+size_t blockSize(int fd);
+
+// The bytes an unprivileged user may still write to the filesystem holding
+// path, or -1 if it is not known.  unit is set to its allocation size.
+int64_t freeSpace(const char *path, size_t &unit);
+
+// Reserves the first length bytes of outFd without changing its size, so
+// filling them in cannot run out of space part way.  Returns false if the
+// filesystem is full.  Where space cannot be reserved it does nothing.
+bool preallocate(int outFd, int64_t length);
+
+#endif // EXTENTCOPY_H
@@ -0,0 +1,125 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+
+#include "foldedindex.h"
+
+FoldedIndex::FoldedIndex()
+{
+
+}
+
+void FoldedIndex::add(std::string_view path, uint32_t record)
+{
+    // Case is folded for all names at once, in sort().
+    uint32_t offset = names.size();
+    appendCleanPath(names, path);
+    entries.push_back(FoldedName{offset, static_cast<uint32_t>(names.size() - offset), record});
+}
+
+void FoldedIndex::sort()
+{
+    foldCase(&names[0], names.size());
+    std::sort(entries.begin(), entries.end(), [this](const FoldedName &a, const FoldedName &b) {
+        auto order = name(a).compare(name(b));
+        return order != 0 ? order < 0 : a.record < b.record;
+    });
+}
+
+void FoldedIndex::build(const PakDirectory &directory)
+{
+    names.clear();
+    entries.clear();
+    names.reserve(directory.size() * 32);
+    entries.reserve(directory.size());
+    for (uint32_t x = 0; x < directory.size(); ++x) {
+        add(labelView(directory[x].filename), x);
+    }
+    sort();
+}
+
+void FoldedIndex::build(const std::vector<std::string_view> &paths)
+{
+    names.clear();
+    entries.clear();
+    entries.reserve(paths.size());
+    for (uint32_t x = 0; x < paths.size(); ++x) {
+        add(paths[x], x);
+    }
+    sort();
+}
+
+std::string_view FoldedIndex::name(const FoldedName &entry) const
+{
+    return std::string_view(names.data() + entry.offset, entry.length);
+}
+
+uint32_t FoldedIndex::findRecord(std::string_view path) const
+{
+    auto wanted = normalizedPath(path);
+    auto found = std::lower_bound(entries.begin(), entries.end(), wanted, [this](const FoldedName &x, const std::string &key) {
+        return name(x) < key;
+    });
+    if (found == entries.end() || name(*found) != wanted) {
+        return NO_RECORD;
+    }
+    return found->record;
+}
+
+uint32_t FoldedIndex::findDirectory(std::string_view path) const
+{
+    auto wanted = normalizedPath(path);
+    if (wanted.empty()) {
+        return NO_RECORD;
+    }
+    wanted += '/';
+    auto found = std::lower_bound(entries.begin(), entries.end(), wanted, [this](const FoldedName &x, const std::string &key) {
+        return name(x) < key;
+    });
+    if (found == entries.end() || name(*found).compare(0, wanted.size(), wanted) != 0) {
+        return NO_RECORD;
+    }
+    return found->record;
+}
+
+std::vector<std::vector<uint32_t>> FoldedIndex::collisions() const
+{
+    std::vector<std::vector<uint32_t>> groups;
+    for (size_t x = 0; x < entries.size();) {
+        size_t y = x + 1;
+        while (y < entries.size() && name(entries[y]) == name(entries[x])) {
+            ++y;
+        }
+        if (y - x > 1) {
+            groups.emplace_back();
+            for (size_t z = x; z < y; ++z) {
+                groups.back().push_back(entries[z].record);
+            }
+        }
+        x = y;
+    }
+    return groups;
+}
+
+size_t FoldedIndex::size() const
+{
+    return entries.size();
+}
@@ -0,0 +1,64 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef FOLDEDINDEX_H
+#define FOLDEDINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pakdirectory.h"
+#include "pakindex.h"
+
+// Index of paths by their normalizedPath() form, for finding entries the
+// way engines that ignore case do.  All the folded names are kept in one
+// string, folded in a single pass, with a sorted array of offsets into it.
+class FoldedIndex
+{
+public:
+    FoldedIndex();
+
+    void build(const PakDirectory &directory);
+    void build(const std::vector<std::string_view> &paths); // Records are positions in paths.
+    uint32_t findRecord(std::string_view path) const; // First record that matches, or NO_RECORD.
+    // The first record found under a directory, or NO_RECORD.
+    uint32_t findDirectory(std::string_view path) const;
+    // Groups of records whose paths differ only in case or separators.
+    std::vector<std::vector<uint32_t>> collisions() const;
+    size_t size() const;
+private:
+    struct FoldedName
+    {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t record;
+    };
+
+    std::string names;
+    std::vector<FoldedName> entries; // Sorted by name, then record.
+
+    void add(std::string_view path, uint32_t record);
+    void sort();
+    std::string_view name(const FoldedName &entry) const;
+};
+
+#endif // FOLDEDINDEX_H
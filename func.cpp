@@ -19,6 +19,9 @@
  */
 
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 
 #include "func.h"
 
@@ -157,3 +160,63 @@ int32_t safeAdd(int32_t a, int32_t b)
   return a + b;
 }
 
+
+std::string_view labelView(const pakDataLabel &label)
+{
+    auto end = std::find(label.begin(), label.end(), '\0');
+    return std::string_view(label.data(), end - label.begin());
+}
+
+void foldCase(char *text, size_t length)
+{
+    // Eight bytes at a time.  The high bit of each byte is cleared before
+    // adding so no carry crosses into the next byte; the additions then
+    // set the high bit of bytes from 'A' and of bytes past 'Z'.
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t high = ones * 0x80;
+    size_t x = 0;
+    for (; x + 8 <= length; x += 8) {
+        uint64_t word;
+        std::memcpy(&word, text + x, 8);
+        uint64_t low = word & ~high;
+        uint64_t fromA = low + ones * (0x80 - 'A');
+        uint64_t pastZ = low + ones * (0x80 - 'Z' - 1);
+        uint64_t upper = ~word & fromA & ~pastZ & high;
+        word |= upper >> 2; // 0x80 >> 2 is the case bit.
+        std::memcpy(text + x, &word, 8);
+    }
+    for (; x < length; ++x) {
+        if (text[x] >= 'A' && text[x] <= 'Z') {
+            text[x] += 'a' - 'A';
+        }
+    }
+}
+
+void appendCleanPath(std::string &out, std::string_view path)
+{
+    auto first = out.size();
+    size_t start = 0;
+    while (start <= path.size()) {
+        auto end = path.find_first_of("/\\", start);
+        if (end == std::string_view::npos) {
+            end = path.size();
+        }
+        auto component = path.substr(start, end - start);
+        if (!component.empty() && component != ".") {
+            if (out.size() != first) {
+                out += '/';
+            }
+            out += component;
+        }
+        start = end + 1;
+    }
+}
+
+std::string normalizedPath(std::string_view path)
+{
+    std::string normal;
+    normal.reserve(path.size());
+    appendCleanPath(normal, path);
+    foldCase(&normal[0], normal.size());
+    return normal;
+}
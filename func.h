@@ -28,6 +28,7 @@
 #include <string>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "pakexception.h"
 
@@ -49,6 +50,7 @@ enum class fileTypes {
   Config,
   Other
 };
+const int FILE_TYPE_COUNT = int(fileTypes::Other) + 1;
 
 
 const int PAK_HEADER_SIZE = 12;
@@ -72,34 +74,57 @@ std::string getFileName(const std::string &filename);
 
 int32_t safeAdd(int32_t a, int32_t b);
 
-template <typename T>
-stringList tokenize(T &text)
+// Walks the directory components of a path, the parts followed by a '/',
+// without copying anything.  Empty components are skipped and the final
+// file name is not returned.
+class PathComponents
 {
-    stringList directoryList;
-    auto pos = text.begin();
-    //auto dirName = &entry.filename;
-
-    while (pos != text.end()) {
-        auto fit = std::find(pos, text.end(), '/');
-        if (fit != text.end()) {
-            auto x = fit - pos;
-            std::string s;
-            s.resize(x);
-            std::copy(pos, fit, s.begin());
-
-            if (s == "..") {
-                s = "dotdot";
+public:
+    explicit PathComponents(std::string_view path) : path(path), pos(0) {}
+
+    bool next(std::string_view &component)
+    {
+        while (pos < path.size()) {
+            auto slash = path.find('/', pos);
+            if (slash == std::string_view::npos) {
+                pos = path.size();
+                return false;
+            }
+            component = path.substr(pos, slash - pos);
+            pos = slash + 1;
+            if (component == "..") {
+                component = "dotdot";
             } // This is a workaround for the Quake 2 pak0.pak file.
             // It contains as a path '..' for the ctank, which screws things up for this program
             // when trying to create this directories.
             // We'll convert this back to '..' when importing.
-
-	    if (s.size() > 0 ) {
-	      directoryList.push_back(s);
-	    }
-            pos = fit;
+            if (!component.empty()) {
+                return true;
+            }
         }
-        pos++;
+        return false;
+    }
+private:
+    std::string_view path;
+    size_t pos;
+};
+
+std::string_view labelView(const pakDataLabel &label); // The label up to the first null.
+void foldCase(char *text, size_t length); // ASCII lower case, in place.
+// Appends path with backslashes turned into '/' and empty and '.'
+// components dropped.
+void appendCleanPath(std::string &out, std::string_view path);
+// The path as engines that ignore case compare it, cleaned and in lower case.
+std::string normalizedPath(std::string_view path);
+
+template <typename T>
+stringList tokenize(T &text)
+{
+    stringList directoryList;
+    PathComponents components(std::string_view(text.data(), text.size()));
+    std::string_view component;
+    while (components.next(component)) {
+        directoryList.emplace_back(component);
     }
     return directoryList;
 }
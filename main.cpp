@@ -30,12 +30,75 @@
 #endif
 
 #include <cassert>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include "pakexception.h"
 #include "exceptionhandler.h"
 
+#include "accesstrace.h"
 #include "pak.h"
+#include "pakdiff.h"
+#include "paklist.h"
+#include "paktypes.h"
+#include "mappedfile.h"
+#include "pakmerge.h"
+#include "pakrepack.h"
+#include "paktar.h"
+#include "pakwatch.h"
+#include "verify.h"
 #include "version.h"
 
+static CancellationToken cancelRequested;
+
+// The first Ctrl-C lets the current operation stop cleanly between
+// entries.  A second one kills the program as usual.
+static void cancelOnSignal(int signum)
+{
+    cancelRequested.cancel();
+    std::signal(signum, SIG_DFL);
+}
+
+// Draws progress as a single line on standard error.
+class ProgressMeter : public ProgressObserver
+{
+public:
+    void progress(const ProgressInfo &info) override
+    {
+        char line[128];
+        const double mb = 1024 * 1024;
+        int used;
+        if (info.entriesTotal > 0) {
+            used = std::snprintf(line, sizeof(line), "%s %lld/%lld files, %.1f/%.1f MB, %.1f MB/s",
+                                 info.operation, (long long)info.entriesDone, (long long)info.entriesTotal,
+                                 info.bytesDone / mb, info.bytesTotal / mb, info.bytesPerSecond / mb);
+        } else {
+            used = std::snprintf(line, sizeof(line), "%s %lld files, %.1f MB, %.1f MB/s", info.operation,
+                                 (long long)info.entriesDone, info.bytesDone / mb, info.bytesPerSecond / mb);
+        }
+        if (info.secondsLeft >= 0 && !info.finished && used > 0 && size_t(used) < sizeof(line)) {
+            std::snprintf(line + used, sizeof(line) - used, ", %.0f s left", info.secondsLeft);
+        }
+        std::cerr << '\r' << line << "\033[K" << (info.finished ? "\n" : "") << std::flush;
+        shown = info.finished ? std::string() : line;
+    }
+
+    // Clears the meter so the message starts on a line of its own, then
+    // draws it again below.
+    void message(const std::string &line) override
+    {
+        if (!shown.empty()) {
+            std::cerr << "\r\033[K" << std::flush;
+        }
+        std::cout << line << std::flush;
+        if (!shown.empty()) {
+            std::cerr << shown << "\033[K" << std::flush;
+        }
+    }
+private:
+    std::string shown; // The report on the terminal, if not finished.
+};
+
 static void printHeader(void)
 {
        std::cout << "PAK: Build and exports PAK files for Quake, Quake 2 and related games.\n"
@@ -56,6 +119,102 @@ static void printLicense(void)
               "along with this program.  If not, see <http://www.gnu.org/licenses/>.\n";
 }
 
+// A size in bytes, with an optional k, M or G suffix.
+static bool parseSize(const std::string &text, int64_t &size)
+{
+    char *end = nullptr;
+    size = std::strtoll(text.c_str(), &end, 10);
+    switch (*end) {
+    case 'k':
+    case 'K':
+        size <<= 10;
+        ++end;
+        break;
+    case 'm':
+    case 'M':
+        size <<= 20;
+        ++end;
+        break;
+    case 'g':
+    case 'G':
+        size <<= 30;
+        ++end;
+        break;
+    }
+    if (end == text.c_str() || *end != '\0' || size < 0) {
+        std::cout << "Invalid size " << text << ".  Use a number of bytes, optionally followed by k, M or G.\n";
+        return false;
+    }
+    return true;
+}
+
+static bool parseOrder(const std::string &name, PakOrder &order)
+{
+    if (name.empty() || name == "offset") {
+        order = PakOrder::Offset;
+    } else if (name == "name") {
+        order = PakOrder::Name;
+    } else if (name == "size") {
+        order = PakOrder::Size;
+    } else if (name == "directory") {
+        order = PakOrder::Directory;
+    } else if (name == "tree") {
+        order = PakOrder::Tree;
+    } else {
+        std::cout << "Unknown order " << name << ".  Use offset, name, size, directory or tree.\n";
+        return false;
+    }
+    return true;
+}
+
+static bool parseFormat(const std::string &name, ListFormat &format)
+{
+    if (name.empty() || name == "text") {
+        format = ListFormat::Text;
+    } else if (name == "json") {
+        format = ListFormat::Json;
+    } else if (name == "csv") {
+        format = ListFormat::Csv;
+    } else if (name == "nul") {
+        format = ListFormat::Nul;
+    } else {
+        std::cout << "Unknown format " << name << ".  Use text, json, csv or nul.\n";
+        return false;
+    }
+    return true;
+}
+
+static void printCacheStats(const BuildCache &cache)
+{
+    std::cout << cache.reusedFiles() << " files reused (" << cache.reusedBytes() << " bytes), "
+              << cache.readFiles() << " files read (" << cache.readBytes() << " bytes).\n";
+}
+
+static void watchDirectory(const std::string &pakfilename, const std::string &directory,
+                           const std::string &prefix, BuildCache *cache, bool verbose)
+{
+#ifdef __linux
+    PakWatcher watcher(pakfilename.c_str(), directory.c_str(), prefix);
+    watcher.setVerbose(verbose);
+    watcher.setBuildCache(cache);
+    watcher.run();
+#else
+    std::cout << "Watching directories is only supported on Linux.\n";
+#endif
+}
+
+// Engines that ignore case can only load one file of each of these groups.
+static void reportCaseCollisions(Pak &pak)
+{
+    for (const auto &x : pak.caseCollisions()) {
+        std::cout << "Warning: these files differ only in case:";
+        for (const auto &y : x) {
+            std::cout << " " << y;
+        }
+        std::cout << "\n";
+    }
+}
+
 static void print_help(void)
 {
     std::cout << "Use : pak [options] -i/-o pakfile.pak -d directory/to/import/from/or/to\n\n"
@@ -68,7 +227,37 @@ static void print_help(void)
 	      " -D File to import/export/delete.\t"
               " -v Increase verbosity.\n"
               " -l List contents of PAK file.\t\t"
-              " -x Delete from this PAK file.\n\n"
+              " -x Delete from this PAK file.\n"
+              " -c Write files from this PAK file to standard output.\n"
+              " -t Write this PAK file to standard output as a tar stream.\n"
+              " -T Build this PAK file from a tar stream on standard input.\n"
+              " -k Verify this PAK file.\t\t"
+              " -j Number of threads to verify with.\n"
+              " -M Write checksum manifest.\t\t"
+              " -C Compare against checksum manifest.\n"
+              " -f Compare this PAK file to another.\t"
+              " -o Output PAK file.\n"
+              " -m Merge PAK files into this one.\t"
+              " -n Do not replace when merging.\n"
+              " -u Store identical files once.\t\t"
+              " -r Repack this PAK file.\n"
+              " -O Order to repack or list in (offset, name, size, directory, tree).\n"
+              " -a Record the files written or exported to this trace file.\n"
+              " -A Repack the files in this trace first, in the order listed.\n"
+              " -B Keep a build cache so unchanged files are reused when importing.\n"
+              " -R Read every file when importing, ignoring the build cache.\n"
+              " -w Keep updating the PAK file as the imported directory changes.\n"
+              " -W Flush written PAK files to disk before replacing the old ones.\n"
+              " -b Align entries on filesystem blocks so rewrites can share them.\n"
+              " -P Show a progress meter while importing, writing or exporting.\n"
+              " -I Ignore case when finding files to write, export or delete.\n"
+              " -y Only list, export or delete files of these types (map, sound, ...).\n"
+              " -z Only list, export or delete files of at least this size.\n"
+              " -Y List the number and size of the files of each type.\n"
+              " -H Clone or hard link identical files when exporting.\n"
+              " -F List format (text, json, csv, nul).\t"
+              " -s List offsets.\n"
+              " -S List directory totals instead of files.\n\n"
               "Pass the filename to the -i option to import files into\n"
               "a new pak file, or pass the filename to the -e option to export files from\n"
               "an existing pak file.  The -d option when importing selects where to\n"
@@ -93,6 +282,39 @@ int main(int argc, char **argv)
     bool exportpak = false;
     bool workWithFile = false;
     bool deleteStuff = false;
+    bool catpak = false;
+    bool tarOut = false;
+    bool tarIn = false;
+    bool verifypak = false;
+    std::string writeManifest;
+    std::string checkManifest;
+    unsigned int threads = 0;
+    bool diffpak = false;
+    std::string outputfilename;
+    bool mergepak = false;
+    bool noReplace = false;
+    bool deduplicate = false;
+    bool repackpak = false;
+    std::string order;
+    std::string recordTrace;
+    std::string traceOrder;
+    bool useCache = false;
+    bool rebuild = false;
+    bool ignoreCase = false;
+    std::string typeNames;
+    std::string minimumSize;
+    bool typeTotals = false;
+    bool linkDuplicates = false;
+    TypeFilter filter;
+    bool watch = false;
+    bool syncWrites = false;
+    bool alignWrites = false;
+    bool showProgress = false;
+    ProgressMeter meter;
+    bool listpak = false;
+    std::string listFormat;
+    bool showOffset = false;
+    bool summary = false;
     bool verbose = false;
     bool pakPath = false;
     char *currentPath = nullptr;
@@ -106,12 +328,100 @@ int main(int argc, char **argv)
         return 0;
     }
 
-    while ((optch = getopt(argc, argv, "l:x:D:p:a:A:e:i:d:Vv")) != -1) {
+    while ((optch = getopt(argc, argv, "c:t:T:k:M:C:j:f:o:m:nur:O:BRwWbPIy:z:YHF:sSl:x:D:p:a:A:e:i:d:Vv")) != -1) {
         switch (optch) {
         case 'x': // Delete
             deleteStuff = true;
             pakfilename = optarg;
             break;
+        case 'c': // Write entries to stdout
+            catpak = true;
+            pakfilename = optarg;
+            break;
+        case 't': // Write a tar stream to stdout
+            tarOut = true;
+            pakfilename = optarg;
+            break;
+        case 'T': // Build from a tar stream on stdin
+            tarIn = true;
+            pakfilename = optarg;
+            break;
+        case 'k': // Verify
+            verifypak = true;
+            pakfilename = optarg;
+            break;
+        case 'M': // Manifest to write when verifying
+            writeManifest = optarg;
+            break;
+        case 'C': // Manifest to compare against when verifying
+            checkManifest = optarg;
+            break;
+        case 'j': // Threads
+            threads = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'f': // Compare with another pak
+            diffpak = true;
+            pakfilename = optarg;
+            break;
+        case 'o': // Output pak
+            outputfilename = optarg;
+            break;
+        case 'm': // Merge into this pak
+            mergepak = true;
+            pakfilename = optarg;
+            break;
+        case 'n': // Conflicting entries are an error when merging
+            noReplace = true;
+            break;
+        case 'u': // Deduplicate
+            deduplicate = true;
+            break;
+        case 'r': // Repack
+            repackpak = true;
+            pakfilename = optarg;
+            break;
+        case 'O': // Order to write or list entries in
+            order = optarg;
+            break;
+        case 'a': // Record the entries read to a trace file
+            recordTrace = optarg;
+            break;
+        case 'A': // Repack in the order of a trace file
+            traceOrder = optarg;
+            break;
+        case 'B': // Keep a build cache
+            useCache = true;
+            break;
+        case 'R': // Ignore the build cache
+            rebuild = true;
+            break;
+        case 'w': // Watch the imported directory
+            watch = true;
+            break;
+        case 'W': // Flush written paks to disk
+            syncWrites = true;
+            break;
+        case 'b': // Block align entries
+            alignWrites = true;
+            break;
+        case 'P': // Progress meter
+            showProgress = true;
+            break;
+        case 'I': // Ignore case in paths
+            ignoreCase = true;
+            break;
+        case 'y': // Only entries of these types
+            typeNames = optarg;
+            break;
+        case 'z': // Only entries at least this large
+            minimumSize = optarg;
+            break;
+        case 'Y': // List type totals
+            typeTotals = true;
+            break;
+        case 'H': // Link duplicates when exporting
+            linkDuplicates = true;
+            break;
         case 'V': // Licence
             printLicense();
             return 0;
@@ -139,26 +449,286 @@ int main(int argc, char **argv)
             pakfilename = optarg;
             break;
         case 'l': // List
+            listpak = true;
             pakfilename = optarg;
-            try {
-                Pak pak(pakfilename.c_str());
-                pak.printChild(pak.rootEntry());
-            } catch (PakException &e) {
-                exceptionHander(e);
-                return 1;
-            }
-           // pak.rootEntry()->traverseForEachChild(&Pak::printChild, &pak);
+            break;
+        case 'F': // List format
+            listFormat = optarg;
+            break;
+        case 's': // List offsets
+            showOffset = true;
+            break;
+        case 'S': // List directory totals
+            summary = true;
             break;
         }			// End switch.
     }				// End while.
 
+    if (!typeNames.empty() && !filter.parse(typeNames)) {
+        std::cout << "Unknown type in " << typeNames << ".  Use map, texture, graphic, sound, demo, model, skin, data, config or other.\n";
+        return 1;
+    }
+    if (!minimumSize.empty()) {
+        int64_t size;
+        if (!parseSize(minimumSize, size)) {
+            return 1;
+        }
+        filter.setMinimumSize(size);
+    }
+
+    if (listpak) {
+        PakOrder listOrder = PakOrder::Tree;
+        ListFormat format;
+        if (!parseFormat(listFormat, format) || (!order.empty() && !parseOrder(order, listOrder))) {
+            return 1;
+        }
+        try {
+            MappedFile pakData(pakfilename.c_str());
+            PakDirectory directory;
+            directory.load(pakData.data(), pakData.size());
+            PakLister lister(directory);
+            lister.setFormat(format);
+            lister.setOrder(listOrder);
+            lister.setShowOffset(showOffset);
+            lister.setSummary(summary);
+            PakTypes types;
+            if (filter.isActive() || typeTotals) {
+                bool listingWad = optind < argc; // Its lumps are typed by the lister.
+                if (!listingWad) {
+                    types.classify(directory, pakData.data());
+                }
+                lister.setFilter(listingWad ? nullptr : &types, filter);
+                lister.setTypeTotals(typeTotals);
+            }
+            std::cout.flush();
+            if (optind < argc) { // List the lumps of a WAD in the PAK file.
+                std::string wadPath = argv[optind][0] == '/' ? argv[optind] + 1 : argv[optind];
+                auto found = std::find_if(directory.begin(), directory.end(), [&wadPath](const PakRecord &x) {
+                    return x.name() == wadPath;
+                });
+                if (found == directory.end() || !directory.inBounds(*found)) {
+                    throw PakException("Could not find entry.", wadPath.c_str());
+                }
+                // The WAD is parsed where it lies in the mapping, without copying it.
+                WadArchive wad;
+                wad.load(pakData.data() + found->position, found->length);
+                lister.writeWad(STDOUT_FILENO, wadPath, wad, found->position);
+            } else {
+                lister.write(STDOUT_FILENO);
+            }
+        } catch (PakException &e) {
+            exceptionHander(e);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (catpak) {
+        stringList catList;
+        if (workWithFile) {
+            catList.push_back(workingpath);
+        }
+        for (auto x = optind; x < argc; ++x) {
+            catList.push_back(argv[x]);
+        }
+        try {
+            Pak pak(pakfilename.c_str(), OpenMode::ReadOnly);
+            pak.setIgnoreCase(ignoreCase);
+            for (auto &x : catList) {
+                if (!x.empty() && x.front() == '/') {
+                    x.erase(0, 1);
+                }
+            }
+            if (catList.size() > 1) {
+                pak.prefetch(catList);
+            }
+            for (const auto &x : catList) {
+                pak.catEntry(x, STDOUT_FILENO);
+            }
+            if (!recordTrace.empty()) {
+                AccessTrace trace;
+                for (const auto &x : catList) {
+                    trace.record(x);
+                }
+                trace.append(recordTrace.c_str());
+            }
+        } catch (PakException &e) {
+            exceptionHander(e, std::cerr); // Keep stdout clean for the consumer.
+            return 1;
+        }
+        return 0;
+    }
+
+    if (tarOut) {
+        try {
+            TarExporter exporter(pakfilename.c_str());
+            exporter.write(STDOUT_FILENO);
+        } catch (PakException &e) {
+            exceptionHander(e, std::cerr); // Keep stdout clean for the consumer.
+            return 1;
+        }
+        return 0;
+    }
+
+    if (tarIn) {
+        try {
+            TarImporter importer(pakfilename.c_str());
+            importer.setVerbose(verbose);
+            importer.setSync(syncWrites);
+            importer.setAlignment(alignWrites);
+            importer.read(STDIN_FILENO);
+            if (verbose) {
+                std::cout << importer.size() << " files added, " << importer.replaced() << " replaced by later copies, "
+                          << importer.skipped() << " other entries skipped.\n";
+            }
+        } catch (PakException &e) {
+            exceptionHander(e);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (verifypak) {
+        try {
+            PakVerifier verifier(pakfilename.c_str());
+            verifier.setThreads(threads);
+            verifier.verify();
+            if (!checkManifest.empty()) {
+                verifier.compareManifest(checkManifest.c_str());
+            }
+            if (!writeManifest.empty()) {
+                verifier.writeManifest(writeManifest.c_str());
+            }
+            for (const auto &x : verifier.problems()) {
+                std::cout << x << "\n";
+            }
+            std::cout << pakfilename << " : " << verifier.directory().size() << " entries, "
+                      << verifier.bytesChecked() << " bytes checked, "
+                      << verifier.problems().size() << " problems found." << std::endl;
+            return verifier.problems().empty() ? 0 : 1;
+        } catch (PakException &e) {
+            exceptionHander(e);
+            return 1;
+        }
+    }
+
+    if (diffpak) {
+        if (optind >= argc) {
+            std::cout << "No PAK file to compare " << pakfilename << " with...\n\n";
+            print_help();
+            return 1;
+        }
+        try {
+            PakDiff diff(pakfilename.c_str(), argv[optind]);
+            auto differences = diff.compare();
+            for (const auto &x : diff.changes()) {
+                switch (x.type) {
+                case ChangeType::Added:
+                    std::cout << "A\t";
+                    break;
+                case ChangeType::Removed:
+                    std::cout << "D\t";
+                    break;
+                case ChangeType::Changed:
+                    std::cout << "M\t";
+                    break;
+                }
+                std::cout << x.name << "\n";
+            }
+            if (verbose) {
+                std::cout << differences << " differences, " << diff.bytesCompared() << " bytes compared.\n";
+            }
+            if (!outputfilename.empty()) {
+                diff.setSync(syncWrites);
+                diff.writePatch(outputfilename.c_str());
+            }
+            return differences == 0 ? 0 : 1;
+        } catch (PakException &e) {
+            exceptionHander(e);
+            return 2;
+        }
+    }
+
+    if (mergepak) {
+        if (optind >= argc) {
+            std::cout << "No PAK files to merge into " << pakfilename << "...\n\n";
+            print_help();
+            return 1;
+        }
+        try {
+            PakMerge merge;
+            merge.setConflictPolicy(noReplace ? ConflictPolicy::Fail : ConflictPolicy::LastWins);
+            merge.setDeduplicate(deduplicate);
+            merge.setSync(syncWrites);
+            merge.setAlignment(alignWrites);
+            for (auto x = optind; x < argc; ++x) {
+                merge.addSource(argv[x]);
+            }
+            merge.write(pakfilename.c_str());
+            if (verbose) {
+                std::cout << pakfilename << " : " << merge.size() << " entries, " << merge.replaced()
+                          << " replaced, " << merge.bytesSaved() << " bytes saved by deduplication.\n";
+            }
+        } catch (PakException &e) {
+            exceptionHander(e);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (repackpak) {
+        PakOrder repackOrder;
+        if (!parseOrder(order, repackOrder)) {
+            return 1;
+        }
+        if (outputfilename.empty()) {
+            outputfilename = pakfilename;
+        }
+        try {
+            PakRepack repack(pakfilename.c_str());
+            repack.setOrder(repackOrder);
+            if (!traceOrder.empty()) {
+                AccessTrace trace;
+                trace.load(traceOrder.c_str());
+                repack.setTrace(trace.paths());
+            }
+            repack.setSync(syncWrites);
+            repack.setAlignment(alignWrites);
+            std::cout << pakfilename << " : " << repack.liveBytes() << " bytes of data in "
+                      << repack.extentCount() << " extents, " << repack.wastedBytes() << " bytes wasted.\n";
+            repack.write(outputfilename.c_str());
+        } catch (PakException &e) {
+            exceptionHander(e);
+            return 1;
+        }
+        return 0;
+    }
+
+    std::signal(SIGINT, cancelOnSignal);
+
     if ( deleteStuff && !workWithFile) {
         try {
             Pak pak(pakfilename.c_str());
+            pak.setSync(syncWrites);
+            pak.setAlignment(alignWrites);
+            pak.setCancellation(&cancelRequested);
+            pak.setProgressObserver(showProgress ? &meter : nullptr);
             if (verbose) {
                 pak.setVerbose(true);
             }
-            pak.deleteChild(workingpath);
+            pak.setIgnoreCase(ignoreCase);
+            if (filter.isActive()) {
+                std::string prefix = workingpath;
+                if (!prefix.empty() && prefix.back() != '/') {
+                    prefix += '/';
+                }
+                auto deleted = pak.deleteMatching(filter, prefix);
+                if (verbose) {
+                    std::cout << deleted << " files deleted.\n";
+                }
+            } else {
+                pak.deleteChild(workingpath);
+            }
             pak.writePak(pakfilename.c_str());
         } catch (PakException &e) {
             exceptionHander(e);
@@ -169,9 +739,14 @@ int main(int argc, char **argv)
         if ( deleteStuff && workWithFile) {
 	  try {
             Pak pak(pakfilename.c_str());
+            pak.setSync(syncWrites);
+            pak.setAlignment(alignWrites);
+            pak.setCancellation(&cancelRequested);
+            pak.setProgressObserver(showProgress ? &meter : nullptr);
             if (verbose) {
                 pak.setVerbose(true);
             }
+            pak.setIgnoreCase(ignoreCase);
             pak.deleteEntry(workingpath);
             pak.writePak(pakfilename.c_str());
         } catch (PakException &e) {
@@ -198,6 +773,10 @@ int main(int argc, char **argv)
 
         try {
             Pak pak(pakfilename.c_str());
+            pak.setSync(syncWrites);
+            pak.setAlignment(alignWrites);
+            pak.setCancellation(&cancelRequested);
+            pak.setProgressObserver(showProgress ? &meter : nullptr);
 	    if (verbose) {
                 pak.setVerbose(true);
             }
@@ -207,6 +786,7 @@ int main(int argc, char **argv)
                 tItem = pak.rootEntry();
             }
             pak.addEntry(insertPath,workingpath.c_str(), tItem);
+            reportCaseCollisions(pak);
             pak.writePak(pakfilename.c_str());
         } catch (PakException &e) {
             exceptionHander(e);
@@ -215,15 +795,43 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    if (workWithFile && exportpak && filter.isActive()) {
+        std::cout << "Cannot use -y or -z with -D, the files to export are named...\n";
+        return 1;
+    }
+
     if (workWithFile && exportpak) {
       auto workingPathPos = workingpath.begin();
       if (*workingPathPos == '/') {
 	workingpath.erase(0, 1);
       }
         try {
-            Pak pak(pakfilename.c_str());
-            TreeItem *tItem = pak.rootEntry()->findTreeItem(workingpath, false);
-            pak.exportEntry(workingpath, tItem);
+            Pak pak(pakfilename.c_str(), OpenMode::ReadOnly);
+            pak.setIgnoreCase(ignoreCase);
+            if (optind < argc) { // More files to export follow the options.
+                stringList exportList{workingpath};
+                for (auto x = optind; x < argc; ++x) {
+                    exportList.push_back(argv[x][0] == '/' ? argv[x] + 1 : argv[x]);
+                }
+                pak.setCancellation(&cancelRequested);
+                pak.setProgressObserver(showProgress ? &meter : nullptr);
+                pak.setLinkDuplicates(linkDuplicates);
+                pak.exportEntries(exportList);
+                if (!recordTrace.empty()) {
+                    AccessTrace trace;
+                    for (const auto &x : exportList) {
+                        trace.record(x);
+                    }
+                    trace.append(recordTrace.c_str());
+                }
+            } else {
+                pak.exportEntry(workingpath);
+                if (!recordTrace.empty()) {
+                    AccessTrace trace;
+                    trace.record(workingpath);
+                    trace.append(recordTrace.c_str());
+                }
+            }
         } catch (PakException &e) {
             exceptionHander(e);
             return 1;
@@ -235,10 +843,40 @@ int main(int argc, char **argv)
     if (pakPath && importpak) {
         insertPath.append("/");
         try {
+            std::string cacheFile = pakfilename + ".cache";
+            BuildCache cache;
+            char *startPath = getcwd(NULL, 0);
             Pak pak(pakfilename.c_str());
+            pak.setSync(syncWrites);
+            pak.setAlignment(alignWrites);
+            pak.setCancellation(&cancelRequested);
+            pak.setProgressObserver(showProgress ? &meter : nullptr);
             TreeItem *tItem = pak.rootEntry()->findTreeItem(insertPath, true);
+            std::string prefix = tItem->pathLabel();
+            if (useCache) {
+                cache.load(cacheFile.c_str());
+                cache.setRebuild(rebuild);
+                cache.setSource(workingpath, prefix);
+                pak.setBuildCache(&cache);
+            }
             pak.importDirectory(workingpath.c_str(), tItem);
+            chdir(startPath);
+            free(startPath);
+            reportCaseCollisions(pak);
             pak.writePak(pakfilename.c_str());
+            if (useCache) {
+                cache.save(cacheFile.c_str());
+                if (verbose) {
+                    printCacheStats(cache);
+                }
+            }
+            if (watch) {
+                pak.close();
+                watchDirectory(pakfilename, workingpath, prefix, useCache ? &cache : nullptr, verbose);
+                if (useCache) {
+                    cache.save(cacheFile.c_str());
+                }
+            }
         } catch (PakException &e) {
             exceptionHander(e);
             return 1;
@@ -250,12 +888,29 @@ int main(int argc, char **argv)
         insertPath.append("/");
         try {
             Pak pak(pakfilename.c_str());
+            pak.setCancellation(&cancelRequested);
+            pak.setProgressObserver(showProgress ? &meter : nullptr);
 	    if (verbose) {
                 pak.setVerbose(true);
             }
 
-            TreeItem *tItem = pak.rootEntry()->findTreeItem(insertPath, false);
-            pak.exportDirectory(workingpath.c_str(), tItem);
+            pak.setLinkDuplicates(linkDuplicates);
+            if (filter.isActive()) {
+                std::string prefix = insertPath;
+                while (!prefix.empty() && prefix.front() == '/') {
+                    prefix.erase(0, 1);
+                }
+                while (prefix.size() > 1 && prefix[prefix.size() - 2] == '/') {
+                    prefix.pop_back();
+                }
+                pak.exportMatching(workingpath.c_str(), filter, prefix == "/" ? std::string() : prefix);
+            } else {
+                TreeItem *tItem = pak.rootEntry()->findTreeItem(insertPath, false);
+                pak.exportDirectory(workingpath.c_str(), tItem);
+            }
+            if (verbose && linkDuplicates) {
+                std::cout << pak.linkedBytes() << " bytes linked instead of written.\n";
+            }
         } catch (PakException &e) {
             exceptionHander(e);
             return 1;
@@ -280,7 +935,13 @@ int main(int argc, char **argv)
 
     if (importpak && !pakPath) {
         try {
+            std::string cacheFile = pakfilename + ".cache";
+            BuildCache cache;
             Pak pak(pakfilename.c_str());
+            pak.setSync(syncWrites);
+            pak.setAlignment(alignWrites);
+            pak.setCancellation(&cancelRequested);
+            pak.setProgressObserver(showProgress ? &meter : nullptr);
             if (verbose) {
                 pak.setVerbose(true);
             }
@@ -288,10 +949,29 @@ int main(int argc, char **argv)
                 workingpath = ".";
             }
 
+            if (useCache) {
+                cache.load(cacheFile.c_str());
+                cache.setRebuild(rebuild);
+                cache.setSource(workingpath, "");
+                pak.setBuildCache(&cache);
+            }
             pak.importDirectory(workingpath.c_str(), nullptr);
             chdir(currentPath);
+            reportCaseCollisions(pak);
             pak.writePak(pakfilename.c_str());
             pak.close();
+            if (useCache) {
+                cache.save(cacheFile.c_str());
+                if (verbose) {
+                    printCacheStats(cache);
+                }
+            }
+            if (watch) {
+                watchDirectory(pakfilename, workingpath, "", useCache ? &cache : nullptr, verbose);
+                if (useCache) {
+                    cache.save(cacheFile.c_str());
+                }
+            }
         } catch (PakException &e) {
             exceptionHander(e);
         }
@@ -305,11 +985,21 @@ int main(int argc, char **argv)
             workingpath = ".";
         }
         try {
-            Pak pak(pakfilename.c_str());
+            Pak pak(pakfilename.c_str(), filter.isActive() ? OpenMode::ReadOnly : OpenMode::ReadWrite);
+            pak.setCancellation(&cancelRequested);
+            pak.setProgressObserver(showProgress ? &meter : nullptr);
             if (verbose) {
                 pak.setVerbose(true);
             }
-            pak.exportPak(workingpath.c_str());
+            pak.setLinkDuplicates(linkDuplicates);
+            if (filter.isActive()) {
+                pak.exportMatching(workingpath.c_str(), filter);
+            } else {
+                pak.exportPak(workingpath.c_str());
+            }
+            if (verbose && linkDuplicates) {
+                std::cout << pak.linkedBytes() << " bytes linked instead of written.\n";
+            }
 
         } catch (PakException &e) {
             exceptionHander(e);
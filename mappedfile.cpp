@@ -0,0 +1,143 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef __WIN32
+#include <sys/mman.h>
+#endif
+
+#include "mappedfile.h"
+
+MappedFile::MappedFile() :
+    fd(-1), m_data(nullptr), m_size(0), m_mapped(false)
+{
+
+}
+
+MappedFile::MappedFile(const char *filename) : MappedFile()
+{
+    open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+void MappedFile::open(const char *filename)
+{
+    close();
+    fd = ::open(filename, O_RDONLY);
+    if (fd == -1) {
+        throw PakException("Could not open file", filename);
+    }
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0) {
+        close();
+        throw PakException("Could not open file", filename);
+    }
+    m_size = statbuf.st_size;
+    if (m_size == 0) {
+        return;
+    }
+
+#ifndef __WIN32
+    void *address = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (address != MAP_FAILED) {
+        m_data = static_cast<const char *>(address);
+        m_mapped = true;
+        return;
+    }
+#endif
+
+    try {
+        buffer.reset(new char[m_size]);
+    } catch (std::bad_alloc &e) {
+        close();
+        throw (PakException("Out of memory", e.what()));
+    }
+    size_t done = 0;
+    while (done < m_size) {
+        auto got = ::pread(fd, buffer.get() + done, m_size - done, done);
+        if (got <= 0) {
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            close();
+            throw PakException("Error loading file", filename);
+        }
+        done += got;
+    }
+    m_data = buffer.get();
+}
+
+void MappedFile::close()
+{
+#ifndef __WIN32
+    if (m_mapped) {
+        munmap(const_cast<char *>(m_data), m_size);
+    }
+#endif
+    buffer.reset(nullptr);
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool MappedFile::isOpen() const
+{
+    return fd != -1;
+}
+
+const char *MappedFile::data() const
+{
+    return m_data;
+}
+
+size_t MappedFile::size() const
+{
+    return m_size;
+}
+
+int MappedFile::fileDescriptor() const
+{
+    return fd;
+}
+
+void MappedFile::adviseSequential()
+{
+#ifndef __WIN32
+    if (m_mapped) {
+        madvise(const_cast<char *>(m_data), m_size, MADV_SEQUENTIAL);
+        madvise(const_cast<char *>(m_data), m_size, MADV_WILLNEED);
+    }
+#endif
+}
@@ -0,0 +1,56 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "pakexception.h"
+
+// Read only view of a whole file.  The file is mapped into memory where the
+// platform allows it, otherwise it is read into a buffer.
+class MappedFile
+{
+public:
+    MappedFile();
+    explicit MappedFile(const char *filename);
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile &operator=(const MappedFile &other) = delete;
+    ~MappedFile();
+
+    void open(const char *filename);
+    void close();
+    bool isOpen() const;
+    const char *data() const;
+    size_t size() const;
+    int fileDescriptor() const;
+    void adviseSequential(); // Hint that the whole file will be read in order.
+private:
+    int fd;
+    const char *m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::unique_ptr<char[]> buffer; // Used when the file could not be mapped.
+};
+
+#endif // MAPPEDFILE_H
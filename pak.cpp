@@ -18,13 +18,17 @@
  *
  */
 
+#include <cstdio>
+#include <unordered_map>
+
+#include "crc32c.h"
 #include "pak.h"
 #include "treeitem.h"
 
 
-Pak::Pak() : memused(0), verbose(false),
+Pak::Pak(std::pmr::memory_resource *resource) : memused(0), verbose(false),
     directoryOffset(PAK_HEADER_SIZE), directoryLength(0), thisDirectoryEntryOffset(0), numEntries(0),
-    m_rootEntry("root", nullptr), loadingDir(false)
+    resource(resource ? resource : &treeMemory), m_rootEntry("root", nullptr, this->resource), dataFd(-1), builder(nullptr), buildCache(nullptr), syncWrites(false), alignWrites(false), linkDuplicates(false), m_linkedBytes(0), readOnly(false), treeLoaded(true), lookups(0), indexBuilt(false), ignoreCase(false), typesClassified(false), loadingDir(false)
 {
 
     file.exceptions ( std::ifstream::failbit | std::ifstream::badbit );
@@ -39,7 +43,17 @@ int Pak::close()
             throw (PakException("Could not close file", "Pakqit could not close the currently open file." ));
         }
     }
-    m_rootEntry.clear();
+    closeDescriptor();
+    clearTree();
+    readOnly = false;
+    treeLoaded = true;
+    directoryTable = PakDirectory();
+    index = PakIndex();
+    indexBuilt = false;
+    foldedIndex = FoldedIndex();
+    m_types = PakTypes();
+    typesClassified = false;
+    lookups = 0;
     return 0;
 }
 
@@ -48,84 +62,348 @@ Pak::~Pak()
     if (file.is_open()) {
         file.close();
     }
+    closeDescriptor();
 }
 
 
-int Pak::open(const char *filename)
+int Pak::open(const char *filename, OpenMode mode)
 {
-    if (fexists(filename) == false) {
+    clearTree(); // Nothing of a previous file is kept.
+    treeMemory.setReadOnly(mode == OpenMode::ReadOnly);
+    if (mode == OpenMode::ReadWrite && fexists(filename) == false) {
         try {
         file.open(filename, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
     } catch (std::istream::failure &e) {
         throw PakException("Could not open file", filename);
         }
     pakFile = filename;
+    treeLoaded = true;
     return 0;
     }
-    
+
+    auto openMode = std::ios_base::in | std::ios_base::binary;
+    if (mode == OpenMode::ReadWrite) {
+        openMode |= std::ios_base::out;
+    }
     try {
-            file.open(filename, std::ios_base::in  | std::ios_base::out | std::ios_base::binary);
+            file.open(filename, openMode);
         } catch (std::istream::failure &e) {
             throw PakException("Could not open file", filename);
         }
-    
-    try {
-        file.read(signature.data(), signature.size());
-        file.read(reinterpret_cast<char *>(&directoryOffset), sizeof(int32_t));
-        file.read(reinterpret_cast<char *>(&directoryLength), sizeof(int32_t));
 
-    } catch (std::istream::failure &e) {
-        std::string message = filename;
-        message +=" : Error loading file.";
-        throw (PakException("Invalid file", message.c_str()));
+    // Only the header and directory table are read here.  The TreeItem
+    // hierarchy is built from them the first time it is needed, so looking
+    // up a single entry does not pay for the whole tree.
+    dataFd = ::open(filename, O_RDONLY);
+    if (dataFd == -1) {
+        throw PakException("Could not open file", filename);
     }
-    if (std::equal(signature.begin(), signature.end(), "PACK") == 0) {
-        std::string message = filename;
-        message +=" is not a valid PAK file";
-        throw (PakException("Invalid file", message.c_str()));
+    directoryTable.load(dataFd);
+    if (ignoreCase) {
+        foldedIndex.build(directoryTable);
     }
-    if (directoryLength % 64 != 0) {
-        throw (PakException("File not valid", "Error reading directory.  File is corrupt or not a PAK file."));
+    numEntries = directoryTable.size();
+    directoryOffset = directoryTable.offset();
+    directoryLength = directoryTable.length();
+    pakFile = filename;
+    readOnly = (mode == OpenMode::ReadOnly);
+    treeLoaded = false;
+
+    return 0;
+
+}
+
+void Pak::clearTree()
+{
+    m_rootEntry.clear();
+    if (resource == &treeMemory) {
+        treeMemory.release();
     }
-    numEntries = (directoryLength / 64);
-    try {
-        file.seekg(directoryOffset, std::ios::beg);
+}
 
-        for (auto x = 0; x < numEntries; ++x) {
+void Pak::TreeMemory::setReadOnly(bool readOnly)
+{
+    current = readOnly ? static_cast<std::pmr::memory_resource *>(&arena) : &pool;
+}
+
+void Pak::TreeMemory::release()
+{
+    arena.release();
+    pool.release();
+}
+
+void *Pak::TreeMemory::do_allocate(size_t bytes, size_t alignment)
+{
+    return current->allocate(bytes, alignment);
+}
+
+void Pak::TreeMemory::do_deallocate(void *p, size_t bytes, size_t alignment)
+{
+    current->deallocate(p, bytes, alignment);
+}
 
+bool Pak::TreeMemory::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
+
+TreeItem *Pak::tree()
+{
+    if (!treeLoaded) {
+        treeLoaded = true;
+        for (const auto &record : directoryTable) {
             DirectoryEntry entry;
-            file.read(entry.filename.data() , PAK_DATA_LABEL_SIZE);
-            int position = entry.getPosition();
-            file.read(reinterpret_cast<char *>(&position), sizeof(int32_t));
-            int32_t length;
-            file.read(reinterpret_cast<char *>(&length), sizeof(int32_t));
-            entry.setLength(length);
-            entry.setPosition(position);
+            entry.filename = record.filename;
+            entry.setLength(record.length);
+            entry.setPosition(record.position);
             loadDir(std::move(entry));
         }
-    } catch (std::istream::failure &e) {
-        throw (PakException("File not valid", "Error reading directory.  File is corrupt or not a PAK file."));
     }
+    return &m_rootEntry;
+}
 
-    pakFile = filename;
+const PakRecord *Pak::findRecord(std::string_view path)
+{
+    auto found = findExactRecord(path);
+    if (found == nullptr && ignoreCase) {
+        auto folded = foldedIndex.findRecord(path);
+        if (folded != NO_RECORD) {
+            found = &directoryTable[folded];
+        }
+    }
+    return found;
+}
+
+const PakRecord *Pak::findExactRecord(std::string_view path)
+{
+    // One lookup is cheaper as a scan of the table than building the
+    // index, so the index is only built once a second lookup is made.
+    if (!indexBuilt && ++lookups < 2) {
+        if (path.size() >= PAK_DATA_LABEL_SIZE) {
+            return nullptr;
+        }
+        for (const auto &record : directoryTable) {
+            if (std::equal(path.begin(), path.end(), record.filename.begin()) && record.filename[path.size()] == '\0') {
+                return &record;
+            }
+        }
+        return nullptr;
+    }
+    if (!indexBuilt) {
+        index.build(directoryTable);
+        indexBuilt = true;
+    }
+    auto found = index.findRecord(path);
+    return found == NO_RECORD ? nullptr : &directoryTable[found];
+}
+
+void Pak::checkBounds(const PakRecord &record)
+{
+    if (!directoryTable.inBounds(record)) {
+        std::string message = record.name();
+        message += " lies outside of the file.  Use -k to check the file.";
+        throw PakException("File not valid", message.c_str());
+    }
+}
+
+bool Pak::readWad(const PakRecord &record, WadArchive &wad)
+{
+    if (record.length < WAD_HEADER_SIZE || !directoryTable.inBounds(record)) {
+        return false;
+    }
+    char header[WAD_HEADER_SIZE];
+    readAll(dataFd, header, WAD_HEADER_SIZE, record.position);
+    if (!WadArchive::isWad(header, WAD_HEADER_SIZE)) {
+        return false;
+    }
+    wad.load(dataFd, record.position, record.length);
+    return true;
+}
+
+const WadLump *Pak::findLump(const std::string &path, WadArchive &wad, int64_t &position)
+{
+    auto slash = path.find_last_of('/');
+    if (slash == std::string::npos) {
+        return nullptr;
+    }
+    const auto *record = findRecord(std::string_view(path).substr(0, slash));
+    if (record == nullptr || !readWad(*record, wad)) {
+        return nullptr;
+    }
+    const auto *lump = wad.find(std::string_view(path).substr(slash + 1));
+    if (lump == nullptr) {
+        return nullptr;
+    }
+    if (lump->compression != 0) {
+        throw PakException("Compressed WAD lumps are not supported", path.c_str());
+    }
+    position = record->position + lump->position;
+    return lump;
+}
 
+const PakTypes &Pak::types()
+{
+    if (!typesClassified) {
+        m_types.classify(directoryTable, dataFd);
+        typesClassified = true;
+    }
+    return m_types;
+}
+
+int Pak::exportMatching(const char *exportPath, const TypeFilter &filter, const std::string &prefix)
+{
+    if (chdir(exportPath) != 0) {
+        throw PakException("Could not open directory", exportPath);
+    }
+    const auto &classified = types();
+    // The directories above the prefix's own are not made.
+    size_t parent = 0;
+    if (prefix.size() > 1) {
+        auto slash = prefix.find_last_of('/', prefix.size() - 2);
+        parent = slash == std::string::npos ? 0 : slash + 1;
+    }
+    std::vector<PlannedFile> plan;
+    std::set<std::string> made;
+    progress.start("Exporting");
+    for (size_t x = 0; x < directoryTable.size(); ++x) {
+        const auto &record = directoryTable[x];
+        auto name = labelView(record.filename);
+        if (!filter.matches(classified.type(x), record.length) || name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        checkBounds(record);
+        name.remove_prefix(parent);
+        // The directories are made as the tree would make them, with '..'
+        // renamed, so nothing is written outside exportPath.
+        PathComponents components(name);
+        std::string_view component;
+        std::string path;
+        while (components.next(component)) {
+            path += component;
+            if (made.insert(path).second) {
+#ifdef __linux
+                mkdir(path.c_str(), S_IRUSR | S_IWUSR | S_IXUSR);
+#elif __WIN32
+                mkdir(path.c_str());
+#elif __APPLE__
+                mkdir(path.c_str(), S_IRUSR | S_IWUSR | S_IXUSR);
+#endif
+            }
+            path += '/';
+        }
+        auto slash = name.find_last_of('/');
+        path += slash == std::string_view::npos ? name : name.substr(slash + 1);
+#ifdef CLI
+        if (fexists(path) && confirmOverwrite(path) == false) {
+            continue;
+        }
+#endif
+        progress.addTotal(record.length);
+        plan.push_back(PlannedFile{record.position, record.length, nullptr, path});
+    }
+    extractPlanned(plan);
+    progress.finish();
     return 0;
+}
+
+size_t Pak::deleteMatching(const TypeFilter &filter, const std::string &prefix)
+{
+    const auto &classified = types();
+    stringList doomed;
+    for (size_t x = 0; x < directoryTable.size(); ++x) {
+        const auto &record = directoryTable[x];
+        auto name = labelView(record.filename);
+        if (filter.matches(classified.type(x), record.length) && name.compare(0, prefix.size(), prefix) == 0) {
+            doomed.emplace_back(name);
+        }
+    }
+    for (const auto &x : doomed) {
+        deleteEntry(x);
+    }
+    return doomed.size();
+}
+
+void Pak::setLinkDuplicates(bool enable)
+{
+    linkDuplicates = enable;
+}
+
+int64_t Pak::linkedBytes() const
+{
+    return m_linkedBytes;
+}
+
+void Pak::setIgnoreCase(bool enable)
+{
+    ignoreCase = enable;
+    if (ignoreCase && foldedIndex.size() != directoryTable.size()) {
+        foldedIndex.build(directoryTable);
+    }
+}
 
+std::string Pak::storedPath(const std::string &path, bool directory)
+{
+    if (!ignoreCase) {
+        return path;
+    }
+    if (!directory) {
+        auto found = findRecord(path);
+        return found ? found->name() : path;
+    }
+    auto found = foldedIndex.findDirectory(path);
+    if (found == NO_RECORD) {
+        return path;
+    }
+    // The same number of components of the first entry under it.
+    auto wanted = normalizedPath(path);
+    auto components = std::count(wanted.begin(), wanted.end(), '/') + 1;
+    std::string stored;
+    appendCleanPath(stored, labelView(directoryTable[found].filename));
+    size_t end = 0;
+    while (components-- > 0) {
+        end = stored.find('/', end) + 1;
+    }
+    return stored.substr(0, end);
+}
+
+void Pak::collectName(DirectoryEntry &entry)
+{
+    collectedNames.push_back(labelView(entry.filename));
+}
+
+std::vector<stringList> Pak::caseCollisions()
+{
+    collectedNames.clear();
+    tree()->traverseForEachItem(&Pak::collectName, this);
+    FoldedIndex names;
+    names.build(collectedNames);
+    std::vector<stringList> groups;
+    for (const auto &x : names.collisions()) {
+        groups.emplace_back();
+        for (auto y : x) {
+            groups.back().emplace_back(collectedNames[y]);
+        }
+    }
+    collectedNames.clear();
+    return groups;
 }
 
 TreeItem *Pak::addChild(stringList &dirList, TreeItem *entry)
 {
-    if (dirList.empty()) {
-        return entry;
+    for (const auto &x : dirList) {
+        entry = entry->findChild(x, true);
     }
+    return entry;
+}
 
-    auto x = entry->findChild(dirList.front(), true);
-    if (x != nullptr) { // There are more
-        dirList.erase(dirList.begin());
-        x = addChild(dirList, x);
-        return x;
+TreeItem *Pak::addChild(std::string_view path, TreeItem *entry)
+{
+    PathComponents components(path);
+    std::string_view x;
+    while (components.next(x)) {
+        entry = entry->findChild(x, true);
     }
-    return x;
+    return entry;
 }
 
 void Pak::updateIndex(DirectoryEntry &entry)
@@ -135,22 +413,34 @@ void Pak::updateIndex(DirectoryEntry &entry)
     directoryOffset = safeAdd(directoryOffset, entry.getLength());
 }
 
+void Pak::measureEntry(DirectoryEntry &entry)
+{
+    directoryLength = safeAdd(directoryLength, DIRECTORY_ENTRY_SIZE);
+    directoryOffset = safeAdd(directoryOffset, entry.getLength());
+}
+
+void Pak::countEntry(DirectoryEntry &entry)
+{
+    progress.addTotal(entry.getLength());
+}
+
 void Pak::resetPakDirectory()
 {
     directoryLength = 0;
     directoryOffset = PAK_HEADER_SIZE;
     thisDirectoryEntryOffset = 0;
-    m_rootEntry.traverseForEachItem(&Pak::updateIndex, this);
+    tree()->traverseForEachItem(&Pak::updateIndex, this);
 }
 
 
 void Pak::deleteChild(std::string path)
 {
+    path = storedPath(path, true);
     if (path.back() != '/') {  // There has to be a '/' at the end
       // to ensure that it is tokenised correctly.
       path.append("/");
     }
-    TreeItem *treeToDelete = m_rootEntry.findTreeItem(path);
+    TreeItem *treeToDelete = tree()->findTreeItem(path);
     if (treeToDelete == nullptr) { // It wasn't found.
         return;
     }
@@ -167,8 +457,9 @@ void Pak::deleteChild(TreeItem *entry, int row)
 }
 
 
-void Pak::deleteEntry(const std::string entry)
+void Pak::deleteEntry(std::string entry)
 { 
+    entry = storedPath(entry, false);
     TreeItem *tItem = nullptr;
     std::string entryItem;
     std::string path;
@@ -176,7 +467,7 @@ void Pak::deleteEntry(const std::string entry)
 
     if (slashPos == std::string::npos) {
         // If no slash, assume we are referring to a top level (root) item.
-        tItem = &m_rootEntry;
+        tItem = tree();
 	entryItem = entry;
     } else {
       // Otherwise, take the part after the slash as the entry (file), and the part before as the path.
@@ -184,7 +475,7 @@ void Pak::deleteEntry(const std::string entry)
       path = entry.substr(0, slashPos);
       entryItem = entry.substr(slashPos, entry.length());
       
-      tItem = m_rootEntry.findTreeItem(path);
+      tItem = tree()->findTreeItem(path);
 
       if (tItem == nullptr) { // It wasn't found.
 	std::string message;
@@ -215,71 +506,328 @@ void Pak::deleteEntry(TreeItem *root, const int row)
 void Pak::loadDir(DirectoryEntry entry)
 {
     // First, we get the position in the directory tree.
-    stringList directoryList;
     clearArrayAfterNull(entry.filename);
-    directoryList = tokenize(entry.filename);
-    auto x = addChild(directoryList, &m_rootEntry);
+    auto x = addChild(labelView(entry.filename), &m_rootEntry);
     x->appendItem(entry);
 }
 
 
-Pak::Pak(const char *filename) : Pak()
+Pak::Pak(const char *filename, OpenMode mode, std::pmr::memory_resource *resource) : Pak(resource)
 {
-    open(filename);
+    open(filename, mode);
 }
 
 void Pak::makeDirectoryTree(TreeItem *item)
 {
+    // Directories are all made first, then the files are written in the
+    // order their data lies in the PAK file, so it is read front to back.
+    std::vector<PlannedFile> plan;
+    planDirectoryTree(item, "", plan);
+    extractPlanned(plan);
+    chdir("..");
+}
 
+void Pak::planDirectoryTree(TreeItem *item, const std::string &prefix, std::vector<PlannedFile> &plan)
+{
     for (auto x = 0; x < item->childCount(); ++x) {
+        std::string directory = prefix;
+        directory += item->child(x)->label();
 #ifdef __linux
-        mkdir(item->child(x)->label().c_str(), S_IRUSR | S_IWUSR | S_IXUSR);
+        mkdir(directory.c_str(), S_IRUSR | S_IWUSR | S_IXUSR);
 #elif __WIN32
-        mkdir(item->child(x)->label().c_str());
+        mkdir(directory.c_str());
 #elif __APPLE__
-        mkdir(item->child(x)->label().c_str(), S_IRUSR | S_IWUSR | S_IXUSR);
+        mkdir(directory.c_str(), S_IRUSR | S_IWUSR | S_IXUSR);
 #endif
-        chdir(item->child(x)->label().c_str());
-        makeDirectoryTree(item->child(x));
+        planDirectoryTree(item->child(x), directory + "/", plan);
     }
 
     for (auto x = 0; x < item->size(); x++) {
-
-        std::ofstream fout;
-
+        auto &entry = item->data(x);
 #ifndef CLI
-        if (fexists(absoluteFileName((item->data(x).filename)).toStdString().c_str())) {
-            if (confirmOverwrite(absoluteFileName((item->data(x).filename)).toStdString().c_str()) == false) {
+        std::string path = prefix + absoluteFileName(entry.filename).toStdString();
+#else
+        std::string path = prefix + absoluteFileName(entry.filename);
+#endif
+        if (fexists(path.c_str())) {
+            if (confirmOverwrite(path.c_str()) == false) {
                 continue;
             }
         }
-        fout.open(absoluteFileName((item->data(x).filename)).toStdString().c_str(), std::ios_base::binary | std::ios_base::out);
-#else
-        if (fexists(absoluteFileName((item->data(x).filename)).c_str())) {
-            if (confirmOverwrite(absoluteFileName((item->data(x).filename)).c_str()) == false) {
-                continue;
+        plan.push_back(PlannedFile{entry.getPosition(), entry.getLength(),
+                                   entry.isLoaded() ? entry.data() : nullptr, path});
+    }
+}
+
+void Pak::extractPlanned(std::vector<PlannedFile> &plan)
+{
+    std::stable_sort(plan.begin(), plan.end(), [](const PlannedFile &a, const PlannedFile &b) {
+        return a.position < b.position || (a.position == b.position && a.length < b.length);
+    });
+    if (linkDuplicates) {
+        markDuplicates(plan);
+    }
+    checkFreeSpace(plan);
+
+    std::vector<char> buffer;
+    size_t x = 0;
+    while (x < plan.size()) {
+        if (plan[x].original != NOT_DUPLICATE) {
+            linkPlanned(plan[x], plan[plan[x].original]);
+            ++x;
+            continue;
+        }
+        if (plan[x].data != nullptr || size_t(plan[x].length) >= EXTRACT_BATCH_SIZE) {
+            writePlanned(plan[x], plan[x].data);
+            ++x;
+            continue;
+        }
+        // Gather the following entries that lie close by into one read,
+        // then hand each its part of it.
+        auto start = plan[x].position;
+        auto end = start + plan[x].length;
+        auto last = x + 1;
+        while (last < plan.size() && plan[last].data == nullptr &&
+               plan[last].position <= end + PREFETCH_GAP &&
+               size_t(plan[last].position + plan[last].length - start) <= EXTRACT_BATCH_SIZE) {
+            end = std::max(end, plan[last].position + plan[last].length);
+            ++last;
+        }
+        buffer.resize(end - start);
+        readAll(fileDescriptor(), buffer.data(), buffer.size(), start);
+        for (; x < last; ++x) {
+            if (plan[x].original != NOT_DUPLICATE) {
+                linkPlanned(plan[x], plan[plan[x].original]);
+            } else {
+                writePlanned(plan[x], buffer.data() + (plan[x].position - start));
+            }
+        }
+    }
+}
+
+// Fails before anything is written when the files of a plan will not fit
+// on the filesystem they go to.  Files that will be linked to a duplicate
+// take no space, and files about to be replaced give theirs back.
+void Pak::checkFreeSpace(const std::vector<PlannedFile> &plan)
+{
+    if (plan.empty()) {
+        return;
+    }
+    const auto &first = plan.front().path;
+    auto slash = first.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : first.substr(0, slash + 1);
+    size_t unit;
+    int64_t available = freeSpace(directory.c_str(), unit);
+    if (available < 0) {
+        return;
+    }
+    int64_t needed = 0;
+    for (const auto &file : plan) {
+        if (file.original != NOT_DUPLICATE) {
+            continue;
+        }
+        needed += (int64_t(file.length) + unit - 1) / unit * unit;
+#ifndef __WIN32
+        struct stat statbuf;
+        if (::stat(file.path.c_str(), &statbuf) == 0 && S_ISREG(statbuf.st_mode) && statbuf.st_nlink == 1) {
+            available += int64_t(statbuf.st_blocks) * 512;
+        }
+#endif
+    }
+    if (needed > available) {
+        std::string message = std::to_string(needed) + " bytes are needed but only " +
+                              std::to_string(available) + " are free.";
+        throw PakException("Not enough space", message.c_str());
+    }
+}
+
+// Finds the files of a plan sorted by position that have the same contents
+// as an earlier one.  Entries sharing an extent are found for free; others
+// are only read and checksummed when another extent has the same length.
+void Pak::markDuplicates(std::vector<PlannedFile> &plan)
+{
+    std::vector<size_t> extents; // The first file of each distinct extent.
+    std::unordered_map<int32_t, size_t> lengths;
+    for (size_t x = 0; x < plan.size(); ++x) {
+        if (plan[x].data != nullptr || plan[x].length == 0) {
+            continue;
+        }
+        if (!extents.empty() && plan[extents.back()].position == plan[x].position &&
+            plan[extents.back()].length == plan[x].length) {
+            plan[x].original = extents.back();
+            continue;
+        }
+        extents.push_back(x);
+        lengths[plan[x].length]++;
+    }
+
+    std::unordered_map<uint64_t, std::vector<size_t>> seen; // By length and checksum.
+    std::vector<char> buffer(COPY_BUFFER_SIZE);
+    for (auto x : extents) {
+        if (lengths[plan[x].length] < 2) {
+            continue;
+        }
+        uint32_t crc = 0;
+        for (int32_t done = 0; done < plan[x].length;) {
+            auto chunk = std::min<size_t>(plan[x].length - done, buffer.size());
+            readAll(fileDescriptor(), buffer.data(), chunk, plan[x].position + done);
+            crc = crc32c(crc, buffer.data(), chunk);
+            done += chunk;
+        }
+        auto &candidates = seen[(uint64_t(uint32_t(plan[x].length)) << 32) | crc];
+        for (auto y : candidates) {
+            if (sameContents(plan[y], plan[x])) {
+                plan[x].original = y;
+                break;
             }
         }
-        if (verbose) {
-            std::cout << "Extracting.. " << absoluteFileName((item->data(x).filename)) << "\n";
+        if (plan[x].original == NOT_DUPLICATE) {
+            candidates.push_back(x);
+        }
+    }
+    // Files sharing an extent with a duplicate link to its original.
+    for (auto &file : plan) {
+        if (file.original != NOT_DUPLICATE && plan[file.original].original != NOT_DUPLICATE) {
+            file.original = plan[file.original].original;
+        }
+    }
+}
+
+bool Pak::sameContents(const PlannedFile &a, const PlannedFile &b)
+{
+    std::vector<char> bufferA(COPY_BUFFER_SIZE);
+    std::vector<char> bufferB(COPY_BUFFER_SIZE);
+    for (int32_t done = 0; done < a.length;) {
+        auto chunk = std::min<size_t>(a.length - done, bufferA.size());
+        readAll(fileDescriptor(), bufferA.data(), chunk, a.position + done);
+        readAll(fileDescriptor(), bufferB.data(), chunk, b.position + done);
+        if (std::memcmp(bufferA.data(), bufferB.data(), chunk) != 0) {
+            return false;
         }
-        fout.open(absoluteFileName((item->data(x).filename)).c_str(), std::ios_base::binary | std::ios_base::out);
+        done += chunk;
+    }
+    return true;
+}
+
+// Makes file a clone of original, which has already been written, or
+// failing that a hard link to it.  Copies it from the PAK file if neither
+// is possible.
+void Pak::linkPlanned(const PlannedFile &file, const PlannedFile &original)
+{
+#ifdef CLI
+    if (verbose) {
+        progress.message("Linking.. " + file.path + " to " + original.path + "\n");
+    }
 #endif
-        if (item->data(x).data() == nullptr) {
-            item->data(x).loadData(file);
+    ::unlink(file.path.c_str()); // Neither replaces an existing file.
+    bool linked = false;
+    int inFd = ::open(original.path.c_str(), O_RDONLY);
+    if (inFd != -1) {
+        int outFd = ::open(file.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (outFd != -1) {
+            linked = cloneFile(inFd, outFd);
+            ::close(outFd);
+            if (!linked) {
+                ::unlink(file.path.c_str());
+            }
         }
-        fout.write(item->data(x).data(), item->data(x).getLength());
-        fout.close();
-        
+        ::close(inFd);
     }
-    chdir("..");
+#ifndef __WIN32
+    if (!linked) {
+        linked = ::link(original.path.c_str(), file.path.c_str()) == 0;
+    }
+#endif
+    if (!linked) {
+        writePlanned(file, nullptr);
+        return;
+    }
+    m_linkedBytes += file.length;
+    progress.advance(file.length);
 }
 
+// Writes one file.  data holds its contents, or is nullptr to copy them
+// straight from the PAK file.
+void Pak::writePlanned(const PlannedFile &file, const char *data)
+{
+#ifdef CLI
+    if (verbose) {
+        progress.message("Extracting.. " + file.path + "\n");
+    }
+#endif
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef __WIN32
+    flags |= O_BINARY;
+#endif
+    int outFd = ::open(file.path.c_str(), flags, 0666);
+    if (outFd == -1) {
+        throw PakException("Error writing file", file.path.c_str());
+    }
+    if (!preallocate(outFd, file.length)) {
+        ::close(outFd);
+        ::unlink(file.path.c_str());
+        throw PakException("Not enough space", file.path.c_str());
+    }
+    try {
+        if (data != nullptr) {
+            writeAll(outFd, data, file.length);
+        } else {
+            copyExtent(fileDescriptor(), file.position, outFd, file.length);
+        }
+    } catch (PakException &) {
+        ::close(outFd);
+        throw;
+    }
+    if (::close(outFd) != 0) {
+        throw PakException("Error writing file", file.path.c_str());
+    }
+    progress.advance(file.length);
+}
+
+int Pak::exportEntries(const stringList &paths)
+{
+    std::vector<PlannedFile> plan;
+    progress.start("Exporting");
+    for (const auto &path : paths) {
+#ifndef CLI
+        std::string name = getFileName(QString(path.c_str())).toStdString();
+#else
+        std::string name = getFileName(path);
+#endif
+        PlannedFile file;
+        if (!treeLoaded) {
+            const auto *record = findRecord(path);
+            if (record == nullptr) {
+                throw PakException("Could not find entry.", path.c_str());
+            }
+            checkBounds(*record);
+            file = PlannedFile{record->position, record->length, nullptr, name};
+        } else {
+            TreeItem *source = tree()->findTreeItem(path, false);
+            auto *entry = (source == nullptr ? tree() : source)->findEntry(path);
+            if (entry == nullptr) {
+                throw PakException("Could not find entry.", path.c_str());
+            }
+            file = PlannedFile{entry->getPosition(), entry->getLength(), entry->isLoaded() ? entry->data() : nullptr, name};
+        }
+        if (fexists(name.c_str()) && confirmOverwrite(name.c_str()) == false) {
+            continue;
+        }
+        progress.addTotal(file.length);
+        plan.push_back(file);
+    }
+    extractPlanned(plan);
+    progress.finish();
+    return 0;
+}
 
 int Pak::exportPak(const char *exportPath)
 {
     chdir(exportPath);
-    makeDirectoryTree(&m_rootEntry);
+    progress.start("Exporting");
+    tree()->traverseForEachItem(&Pak::countEntry, this);
+    makeDirectoryTree(tree());
+    progress.finish();
     return 0;
 }
 
@@ -295,7 +843,10 @@ int Pak::exportDirectory(const char *exportPath, TreeItem *item)
     mkdir(item->label().c_str(), S_IRUSR | S_IWUSR | S_IXUSR);
 #endif
     chdir(item->label().c_str());
+    progress.start("Exporting");
+    item->traverseForEachItem(&Pak::countEntry, this);
     makeDirectoryTree(item);
+    progress.finish();
     return 0;
 }
 
@@ -317,29 +868,41 @@ int Pak::writePakDir(TreeItem *item)
 
 int Pak::writePak(const char *filename)
 {
+    // Entries that have not been loaded are copied straight from the
+    // current PAK file, so the new one is written alongside it and only
+    // replaces it once complete.
+    if (readOnly) {
+        throw PakException("File opened read only", pakFile.c_str());
+    }
+
     if (file.is_open()) {
-        m_rootEntry.traverseForEachItem(&Pak::loadData, this);
         file.close();
     }
 
-    // Close the pakFile at the end, as we will be opening a new one
-    // based on the file name provided.
-    resetPakDirectory();
+    PakBuilder newPak(filename);
+    newPak.setSync(syncWrites);
+    newPak.setAlignment(alignWrites);
+    // The final size is known up front, so it can be reserved in one piece.
+    directoryOffset = PAK_HEADER_SIZE;
+    directoryLength = 0;
+    tree()->traverseForEachItem(&Pak::measureEntry, this);
+    newPak.reserve(int64_t(directoryOffset) + directoryLength);
+    progress.start("Writing", directoryLength / DIRECTORY_ENTRY_SIZE, directoryOffset - PAK_HEADER_SIZE);
     try {
-        file.open(filename, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
-
-    } catch (std::istream::failure &e) {
-        throw PakException("Could not open file", filename);
+        builder = &newPak;
+        tree()->traverseForEachItem(&Pak::writeEntry, this);
+        builder = nullptr;
+    } catch (PakException &) {
+        builder = nullptr;
+        throw;
     }
-    file.seekp(PAK_HEADER_SIZE);
-
-    m_rootEntry.traverseForEachItem(&Pak::writeEntry, this);
-    
-    file.seekp(std::ios::beg);
-    file.write("PACK", signature.size());
-    file.write(reinterpret_cast<char *>(&directoryOffset), sizeof(int32_t));
-    file.write(reinterpret_cast<char *>(&directoryLength), sizeof(int32_t));
-    file.close();
+    directoryOffset = newPak.bytesWritten();
+    directoryLength = newPak.size() * DIRECTORY_ENTRY_SIZE;
+    newPak.finish();
+    closeDescriptor();
+    newPak.commit();
+    progress.finish();
+    pakFile = filename;
 
     return 0;
 }
@@ -361,29 +924,182 @@ int Pak::exportEntry(std::string &entryname, TreeItem* source)
 
 
 
+int Pak::exportEntry(const std::string &entryname)
+{
+    if (treeLoaded) {
+        std::string name = entryname;
+        return exportEntry(name, tree());
+    }
+    const auto *record = findRecord(entryname);
+    if (record == nullptr) {
+        WadArchive wad;
+        int64_t position;
+        const auto *lump = findLump(entryname, wad, position);
+        if (lump == nullptr) {
+            throw PakException("Could not find entry.", entryname.c_str());
+        }
+        // Lump names come from the WAD, so they must not lead anywhere else.
+        if (lump->name.empty() || lump->name == "." || lump->name == ".." ||
+            lump->name.find_first_of("/\\") != std::string::npos) {
+            throw PakException("Invalid lump name", lump->name.c_str());
+        }
+#ifdef CLI
+        if (fexists(lump->name) && confirmOverwrite(lump->name) == false) {
+            return 0;
+        }
+#endif
+        writePlanned(PlannedFile{position, lump->diskSize, nullptr, lump->name}, nullptr);
+        return 0;
+    }
+    checkBounds(*record);
+    DirectoryEntry entry;
+    entry.filename = record->filename;
+    entry.setLength(record->length);
+    entry.setPosition(record->position);
+    entry.exportFile(getFileName(entryname).c_str(), file);
+    return 0;
+}
+
+int Pak::catEntry(const std::string &entryname, int outFd)
+{
+    if (!treeLoaded) {
+        const auto *record = findRecord(entryname);
+        if (record == nullptr) {
+            WadArchive wad;
+            int64_t position;
+            const auto *lump = findLump(entryname, wad, position);
+            if (lump == nullptr) {
+                throw PakException("Could not find entry.", entryname.c_str());
+            }
+            copyExtent(dataFd, position, outFd, lump->diskSize);
+            return 0;
+        }
+        if (!directoryTable.inBounds(*record)) {
+            throw PakException("Entry lies outside the file", entryname.c_str());
+        }
+        copyExtent(dataFd, record->position, outFd, record->length);
+        return 0;
+    }
+
+    TreeItem *source = tree()->findTreeItem(entryname, false);
+    if (source == nullptr) {
+        source = &m_rootEntry;
+    }
+    auto *entry = source->findEntry(entryname);
+    if (entry == nullptr) {
+        throw PakException("Could not find entry.", entryname.c_str());
+    }
+
+    if (entry->isLoaded()) { // Not yet written to the pak, so only in memory.
+        writeAll(outFd, entry->data(), entry->getLength());
+    } else {
+        copyExtent(fileDescriptor(), entry->getPosition(), outFd, entry->getLength());
+    }
+    return 0;
+}
+
+void Pak::prefetch(const stringList &paths)
+{
+    std::vector<ByteRange> ranges;
+    for (const auto &path : paths) {
+        if (!treeLoaded) {
+            const auto *record = findRecord(path);
+            if (record != nullptr) {
+                ranges.push_back(ByteRange{record->position, record->length});
+            }
+            continue;
+        }
+        try {
+            TreeItem *source = tree()->findTreeItem(path, false);
+            auto *entry = (source == nullptr ? tree() : source)->findEntry(path);
+            if (entry != nullptr && !entry->isLoaded()) {
+                ranges.push_back(ByteRange{entry->getPosition(), entry->getLength()});
+            }
+        } catch (PakException &) { // Directory not found.
+        }
+    }
+    if (!ranges.empty()) {
+        prefetcher.start(fileDescriptor(), std::move(ranges));
+    }
+}
+
+int Pak::fileDescriptor()
+{
+    if (dataFd == -1) {
+        dataFd = ::open(pakFile.c_str(), O_RDONLY);
+        if (dataFd == -1) {
+            throw PakException("Could not open file", pakFile.c_str());
+        }
+    }
+    return dataFd;
+}
+
+void Pak::setSync(bool enable)
+{
+    syncWrites = enable;
+}
+
+void Pak::setAlignment(bool enable)
+{
+    alignWrites = enable;
+}
+
+void Pak::setProgressObserver(ProgressObserver *observer)
+{
+    progress.setObserver(observer);
+}
+
+void Pak::setCancellation(const CancellationToken *token)
+{
+    progress.setCancellation(token);
+}
+
+bool Pak::isReadOnly() const
+{
+    return readOnly;
+}
+
+void Pak::closeDescriptor()
+{
+    prefetcher.wait();
+    if (dataFd != -1) {
+        ::close(dataFd);
+        dataFd = -1;
+    }
+}
+
+
 void Pak::reset()
 {
     if (file.is_open()) {
         file.close();
     }
+    closeDescriptor();
     directoryLength = 0;
     directoryOffset = PAK_HEADER_SIZE;
-    m_rootEntry.clear();
+    clearTree();
+    readOnly = false;
+    treeLoaded = true;
+    directoryTable = PakDirectory();
+    index = PakIndex();
+    indexBuilt = false;
+    foldedIndex = FoldedIndex();
+    m_types = PakTypes();
+    typesClassified = false;
+    lookups = 0;
     memused = 0;
 
 }
 
 void Pak::writeEntry(DirectoryEntry &entry)
 {
-    file.seekp(entry.getPosition());
-    file.write(entry.data(), entry.getLength());
-    file.seekp(directoryOffset + thisDirectoryEntryOffset);
-    thisDirectoryEntryOffset = safeAdd(thisDirectoryEntryOffset, DIRECTORY_ENTRY_SIZE);
-    file.write(entry.filename.data(), PAK_DATA_LABEL_SIZE);
-    int32_t position = entry.getPosition();
-    file.write(reinterpret_cast<char *>(&position), sizeof(int32_t));
-    int length = entry.getLength();
-    file.write(reinterpret_cast<char *>(&length), sizeof(int32_t));
+    if (entry.isLoaded()) {
+        builder->addData(entry.filename, entry.data(), entry.getLength());
+    } else {
+        builder->addExtent(entry.filename, fileDescriptor(), entry.getPosition(), entry.getLength());
+    }
+    entry.setPosition(builder->lastPosition());
+    progress.advance(entry.getLength());
     return;
 }
 
@@ -429,6 +1145,10 @@ int Pak::addEntry(std::string path, const char *filename, TreeItem *rootItem)
     stat(filename, &statbuf);
     auto filesize = statbuf.st_size;
 
+    if (buildCache != nullptr && reuseEntry(path, statbuf, rootItem)) {
+        return NO_ERROR;
+    }
+
     newEntry.setLength(filesize);
     newEntry.loadData(filename);
     newEntry.setPosition(directoryOffset);
@@ -436,7 +1156,7 @@ int Pak::addEntry(std::string path, const char *filename, TreeItem *rootItem)
     rootItem->appendItem(newEntry);
 #ifdef CLI
     if (verbose) {
-      std::cout << path << "\t" << newEntry.getLength() << " bytes \n";
+      progress.message(path + "\t" + std::to_string(newEntry.getLength()) + " bytes \n");
     }
 #endif
     return NO_ERROR;
@@ -451,14 +1171,16 @@ int Pak::importDirectory(const char *importPath, TreeItem *rootItem)
     DIR *directory;
 
     if (loadingDir == false && rootItem == nullptr) {
-        rootItem = &m_rootEntry;
+        rootItem = tree();
         initialTreeRoot = rootItem;
         loadingDir = true;
+        progress.start("Importing");
     }
     if (loadingDir == false && rootItem != nullptr) {
         currentPath = rootItem->pathLabel();
         initialTreeRoot = rootItem;
         loadingDir = true;
+        progress.start("Importing");
     }
     currentPath = rootItem->pathLabel();
 
@@ -499,6 +1221,7 @@ int Pak::importDirectory(const char *importPath, TreeItem *rootItem)
         } else if (S_ISREG(statbuf.st_mode)) {
             try {
                 addEntry(currentPath, entry->d_name, rootItem);
+                progress.advance(statbuf.st_size);
             } catch (PakException& )  {
                 loadingDir = false;
                 currentPath.clear();
@@ -512,13 +1235,65 @@ int Pak::importDirectory(const char *importPath, TreeItem *rootItem)
 
     if (rootItem == initialTreeRoot) {
         // We've reached the end of the recursion.  Reset the string
+        if (buildCache != nullptr) {
+            removeStaleEntries(currentPath);
+        }
         currentPath.clear();
         loadingDir = false;
+        progress.finish();
     }
 
     return NO_ERROR;
 }
 
+// Called by addEntry() when importing with a build cache.  Returns true if
+// the existing entry can be kept as it is, otherwise removes any older copy
+// of a file we imported from the same directory before, so it can be
+// replaced.
+bool Pak::reuseEntry(const std::string &path, const struct stat &statbuf, TreeItem *rootItem)
+{
+    auto *existing = rootItem->findEntry(path);
+    if (existing == nullptr) {
+        buildCache->update(path, statbuf);
+        buildCache->countRead(statbuf.st_size);
+        return false;
+    }
+    if (buildCache->unchanged(path, statbuf) && existing->getLength() == statbuf.st_size) {
+        buildCache->update(path, statbuf);
+        buildCache->countReused(statbuf.st_size);
+        return true;
+    }
+    if (buildCache->imported(path)) {
+#ifndef CLI // This uses QString
+        rootItem->deleteItem(rootItem->findEntryRow(getFileName(QString(path.c_str())).toStdString()));
+#else
+        rootItem->deleteItem(rootItem->findEntryRow(getFileName(path)));
+#endif
+    }
+    buildCache->update(path, statbuf);
+    buildCache->countRead(statbuf.st_size);
+    return false;
+}
+
+// Files that were imported from this directory by an earlier run but have
+// since been deleted from it.
+void Pak::removeStaleEntries(const std::string &prefix)
+{
+    for (const auto &x : buildCache->stale(prefix)) {
+        try {
+            deleteEntry(x);
+        } catch (PakException &) {
+            // Already gone from the PAK file.
+        }
+        buildCache->remove(x);
+    }
+}
+
+void Pak::setBuildCache(BuildCache *cache)
+{
+    buildCache = cache;
+}
+
 void Pak::setVerbose(bool verbosity)
 {
     verbose = verbosity;
@@ -543,7 +1318,7 @@ void Pak::printChild(TreeItem *item)
 
 TreeItem *Pak::rootEntry()
 {
-    return &m_rootEntry;
+    return tree();
 }
 
 std::fstream &Pak::getFileHandle()
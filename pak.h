@@ -36,7 +36,7 @@
 #include <errno.h>
 #include <map>
 #include <dirent.h>
-//#include <sys/statfs.h>
+#include <memory_resource>
 
 #ifndef CLI
 #include <QDebug>
@@ -50,6 +50,16 @@
 #include "treeitem.h"
 
 #include "func.h"
+#include "extentcopy.h"
+#include "pakbuilder.h"
+#include "buildcache.h"
+#include "pakdirectory.h"
+#include "pakindex.h"
+#include "foldedindex.h"
+#include "paktypes.h"
+#include "wadarchive.h"
+#include "progress.h"
+#include "prefetch.h"
 
 #ifndef CLI
 #include "qfunc.h"
@@ -57,6 +67,9 @@
 
 using pakSignature = std::array<char, 4>;
 
+// Entries lying close together are read with one read of up to this size when exporting.
+const size_t EXTRACT_BATCH_SIZE = 1 << 23;
+
 enum Errors {
     NO_ERROR,
     NOT_PACK_FILE,
@@ -67,17 +80,29 @@ enum Errors {
 
 };
 
+// How a PAK file is opened.  Either way only the directory table is read,
+// and the TreeItem hierarchy is built the first time it is needed.
+// ReadOnly refuses to write the PAK file back.
+enum class OpenMode {
+    ReadWrite,
+    ReadOnly
+};
+
 class Pak
 {
     friend DirectoryEntry;
     friend TreeItem;
 
 public:
-    Pak(const char *filename);
-    Pak();
+    // The TreeItem hierarchy is allocated from resource.  By default that
+    // is an arena belonging to this Pak, which is freed all at once by
+    // close(), so opening many PAK files one after another costs little
+    // more than reading them.
+    Pak(const char *filename, OpenMode mode = OpenMode::ReadWrite, std::pmr::memory_resource *resource = nullptr);
+    explicit Pak(std::pmr::memory_resource *resource = nullptr);
     ~Pak();
 
-    int open(const char *filename);
+    int open(const char *filename, OpenMode mode = OpenMode::ReadWrite);
     int close();
     int exportPak(const char *exportPath);
     int exportDirectory(const char *exportPath, TreeItem *rootItem = nullptr);
@@ -85,17 +110,55 @@ public:
     void writeEntry(DirectoryEntry &entry);
     int writePak(const char *filename);
     int exportEntry( std::string& entryname, TreeItem* source );
+    // Export one entry without building the tree.  A lump in a WAD inside
+    // the PAK file, named as in gfx.wad/conchars, is exported to a file
+    // named after the lump.
+    int exportEntry(const std::string &entryname);
+    int exportEntries(const stringList &paths); // Export entries to the current directory, in file order.
+    // Export the entries matching filter below exportPath, keeping their
+    // paths.  Only directories holding matching entries are made.  Given a
+    // prefix, only entries under it are exported, from its last directory
+    // down, as exportDirectory() would.
+    int exportMatching(const char *exportPath, const TypeFilter &filter, const std::string &prefix = std::string());
+    // Delete the entries matching filter, only those under prefix if given.
+    size_t deleteMatching(const TypeFilter &filter, const std::string &prefix);
+    const PakTypes &types(); // The type of every entry in the file, classified on first use.
+    int catEntry(const std::string &entryname, int outFd); // Stream an entry, or a lump of a WAD in it, to a descriptor, such as stdout.
+    // Start reading the given entries into the page cache in the background,
+    // in file order, ahead of reading them.  Unknown paths are ignored.
+    void prefetch(const stringList &paths);
     void reset(); // Clears the pak file.  Start new.  // Loses all changes
     TreeItem *addChild(stringList &dirList, TreeItem *entry);
+    TreeItem *addChild(std::string_view path, TreeItem *entry); // Directories of path, created as needed.
     void deleteChild(TreeItem *entry, const int row);
     void deleteChild(std::string path);
     void deleteEntry(TreeItem *root, const int row);
-    void deleteEntry(const std::string entry); // Incomplete.
+    void deleteEntry(std::string entry); // Incomplete.
     void updateIndex(DirectoryEntry &entry);
-    TreeItem *rootEntry(void);
+    void measureEntry(DirectoryEntry &entry); // Adds the entry to directoryOffset and directoryLength only.
+    void countEntry(DirectoryEntry &entry); // Adds the entry to the progress total.
+    TreeItem *rootEntry(void); // Builds the tree if it has not been built yet.
+    const PakRecord *findRecord(std::string_view path); // Look up an entry without building the tree.  nullptr if not found.
+    // Find entries whatever the case of their path and its separators, as
+    // engines on Windows do, when an exact match is not found.
+    void setIgnoreCase(bool enable);
+    std::vector<stringList> caseCollisions(); // Groups of entries whose paths differ only in case.
     void setVerbose(bool verbosity);
     std::fstream &getFileHandle(void);
+    int fileDescriptor(void); // Read only descriptor for the open pak, for raw range reads.
+    bool isReadOnly(void) const;
     int addEntry(std::string path, const char*filename, TreeItem *rootItem);
+    void setSync(bool enable); // Make sure written PAK files are on disk before they replace the old ones.
+    void setAlignment(bool enable); // Start larger entries on filesystem block boundaries when writing.
+    // When exporting, clone or hard link files with the same contents as
+    // one already written rather than writing them again.
+    void setLinkDuplicates(bool enable);
+    int64_t linkedBytes() const; // Bytes not written because of setLinkDuplicates().
+    // Report progress of importing, writing and exporting.  nullptr to stop.
+    void setProgressObserver(ProgressObserver *observer);
+    // Stop importing, writing or exporting with a PakException once token is cancelled.
+    void setCancellation(const CancellationToken *token);
+    void setBuildCache(BuildCache *cache); // Reuse unchanged files when importing.  nullptr to stop.
 #ifdef CLI
     void printChild(TreeItem *item);
 #endif
@@ -109,13 +172,87 @@ private:
     int32_t thisDirectoryEntryOffset;
     int numEntries;
 // std::vector<DirectoryEntry> entries;
+    // Where the tree is allocated from unless another resource is given.
+    // A read only PAK file's tree is only ever built and thrown away, so
+    // it comes from a monotonic arena.  Otherwise deleting entries,
+    // regrowing vectors and replacing labels would leave dead memory in
+    // the arena until close(), so a pool that reuses it is used instead.
+    // The mode is only switched while the tree is empty.
+    class TreeMemory : public std::pmr::memory_resource
+    {
+    public:
+        void setReadOnly(bool readOnly);
+        void release(); // Frees everything.  The tree must be empty.
+    private:
+        std::pmr::monotonic_buffer_resource arena;
+        std::pmr::unsynchronized_pool_resource pool;
+        std::pmr::memory_resource *current = &pool;
+
+        void *do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+    };
+    TreeMemory treeMemory;
+    std::pmr::memory_resource *resource; // treeMemory, unless another was given.
     TreeItem m_rootEntry;
     std::fstream file;
+    int dataFd;
+    PakBuilder *builder; // Set while writePak is writing.
+    BuildCache *buildCache;
+    bool syncWrites;
+    bool alignWrites;
+    bool linkDuplicates;
+    int64_t m_linkedBytes;
+    ProgressTracker progress;
+    Prefetcher prefetcher;
+    bool readOnly;
+    PakDirectory directoryTable; // As read by open(), before any changes.
+    PakIndex index;
+    bool treeLoaded; // Whether m_rootEntry has been built from directoryTable.
+    int lookups;
+    bool indexBuilt;
+    bool ignoreCase;
+    FoldedIndex foldedIndex; // Built by open() when ignoring case.
+    PakTypes m_types;
+    bool typesClassified;
+    std::vector<std::string_view> collectedNames; // Filled by collectName().
     bool loadingDir; // This is used by importDir so that when it calls itself, it knows whether is in the the process
     // of recursion, or just starting.
 
     void resetPakDirectory();
+    void clearTree(); // Empties m_rootEntry and releases the arena.
+    TreeItem *tree(); // m_rootEntry, built on first use.
+    const PakRecord *findExactRecord(std::string_view path);
+    // The lump a path such as gfx.wad/conchars names, with the position of
+    // its data in the PAK file.  nullptr if it is not one.
+    const WadLump *findLump(const std::string &path, WadArchive &wad, int64_t &position);
+    bool readWad(const PakRecord &record, WadArchive &wad); // false if the entry is not a WAD.
+    void checkBounds(const PakRecord &record); // Throws if its data lies outside the file.
+    std::string storedPath(const std::string &path, bool directory); // The spelling of path in the PAK file when ignoring case.
+    void collectName(DirectoryEntry &entry);
+    void closeDescriptor();
+    bool reuseEntry(const std::string &path, const struct stat &statbuf, TreeItem *rootItem);
+    void removeStaleEntries(const std::string &prefix);
+    // A file to be written by extractPlanned().  data is set for entries
+    // that are only in memory.
+    struct PlannedFile
+    {
+        int64_t position;
+        int32_t length;
+        const char *data;
+        std::string path;
+        size_t original = NOT_DUPLICATE; // Earlier file in the plan with the same contents.
+    };
+    static const size_t NOT_DUPLICATE = SIZE_MAX;
+
     void makeDirectoryTree(TreeItem *item);
+    void planDirectoryTree(TreeItem *item, const std::string &prefix, std::vector<PlannedFile> &plan);
+    void extractPlanned(std::vector<PlannedFile> &plan);
+    void checkFreeSpace(const std::vector<PlannedFile> &plan);
+    void writePlanned(const PlannedFile &file, const char *data);
+    void markDuplicates(std::vector<PlannedFile> &plan);
+    bool sameContents(const PlannedFile &a, const PlannedFile &b);
+    void linkPlanned(const PlannedFile &file, const PlannedFile &original);
 
     void loadDir(DirectoryEntry entry);
     int writePakDir(TreeItem *item);
@@ -0,0 +1,335 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __WIN32
+#include <io.h>
+#endif
+#ifndef __WIN32
+#include <sys/uio.h>
+#endif
+
+#include "extentcopy.h"
+#include "pakbuilder.h"
+
+static int syncFile(int fd)
+{
+#ifdef __linux
+    return fdatasync(fd);
+#elif __WIN32
+    return _commit(fd);
+#else
+    return fsync(fd);
+#endif
+}
+
+PakBuilder::PakBuilder(const char *filename) :
+    pakFile(filename), tempFile(filename), sync(false), committed(false), alignment(0), dataEnd(PAK_HEADER_SIZE),
+    staging(WRITE_BATCH_SIZE), staged(0), extentFd(-1), extentOffset(0), extentLength(0)
+{
+    // The temporary file has to be on the same file system as the target
+    // for rename() to replace it atomically, so it goes in the same directory.
+#ifdef __WIN32
+    tempFile += ".tmp";
+    fd = ::open(tempFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+#else
+    tempFile += ".XXXXXX";
+    fd = ::mkstemp(&tempFile[0]);
+#endif
+    if (fd == -1) {
+        throw PakException("Could not open file", filename);
+    }
+#ifndef __WIN32
+    // mkstemp() creates the file readable only by its owner.  Give it the
+    // permissions of the file it replaces, or those of a newly created file.
+    struct stat existing;
+    if (stat(filename, &existing) == 0) {
+        fchmod(fd, existing.st_mode & 07777);
+    } else {
+        auto mask = umask(0);
+        umask(mask);
+        fchmod(fd, 0666 & ~mask);
+    }
+#endif
+    // The header is filled in by finish(), once the directory position is known.
+    char header[PAK_HEADER_SIZE] = {};
+    writeAll(fd, header, PAK_HEADER_SIZE);
+}
+
+PakBuilder::~PakBuilder()
+{
+    if (fd != -1) {
+        ::close(fd);
+    }
+    if (!committed) {
+        std::remove(tempFile.c_str());
+    }
+}
+
+void PakBuilder::reserve(int64_t bytes)
+{
+#ifdef __linux
+    // Only a hint, so that the file is laid out in one piece.  Keeping the
+    // size means a short reservation or early failure leaves nothing behind.
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, bytes);
+#else
+    (void)bytes;
+#endif
+}
+
+void PakBuilder::setSync(bool enable)
+{
+    sync = enable;
+}
+
+void PakBuilder::setAlignment(bool enable)
+{
+    alignment = enable ? blockSize(fd) : 0;
+}
+
+// Pads with zeros so an entry of length bytes starts on a block boundary.
+// Smaller entries are not worth the padding.
+void PakBuilder::align(int32_t length)
+{
+    if (alignment == 0 || size_t(length) < alignment || dataEnd % alignment == 0) {
+        return;
+    }
+    size_t padding = alignment - dataEnd % alignment;
+    dataEnd = safeAdd(dataEnd, padding);
+    flushExtent();
+    while (padding > 0) {
+        if (staged == staging.size()) {
+            flushData();
+        }
+        auto chunk = std::min(padding, staging.size() - staged);
+        std::memset(staging.data() + staged, 0, chunk);
+        staged += chunk;
+        padding -= chunk;
+    }
+}
+
+void PakBuilder::addRecord(const pakDataLabel &name, int32_t length)
+{
+    align(length);
+    PakRecord record;
+    record.filename = name;
+    record.position = dataEnd;
+    record.length = length;
+    dataEnd = safeAdd(dataEnd, length);
+    records.push_back(record);
+}
+
+void PakBuilder::addExtent(const pakDataLabel &name, int sourceFd, off_t offset, int32_t length)
+{
+    addRecord(name, length);
+    queueExtent(sourceFd, offset, length);
+}
+
+void PakBuilder::addStream(const pakDataLabel &name, int sourceFd, int32_t length)
+{
+    addRecord(name, length);
+    flushData();
+    flushExtent();
+    copyStream(sourceFd, fd, length);
+}
+
+void PakBuilder::addData(const pakDataLabel &name, const char *data, int32_t length)
+{
+    addRecord(name, length);
+    queueData(data, length);
+}
+
+int32_t PakBuilder::appendExtent(int sourceFd, off_t offset, int32_t length)
+{
+    align(length);
+    auto position = dataEnd;
+    dataEnd = safeAdd(dataEnd, length);
+    queueExtent(sourceFd, offset, length);
+    return position;
+}
+
+void PakBuilder::queueData(const char *data, size_t length)
+{
+    flushExtent();
+    if (staged + length <= staging.size()) {
+        std::memcpy(staging.data() + staged, data, length);
+        staged += length;
+    } else if (length < staging.size()) {
+        flushData();
+        std::memcpy(staging.data(), data, length);
+        staged = length;
+    } else {
+        flushData(data, length); // Too big to be worth copying.
+    }
+}
+
+void PakBuilder::queueExtent(int sourceFd, off_t offset, size_t length)
+{
+    if (length == 0) {
+        return;
+    }
+    if (extentLength != 0 && sourceFd == extentFd && offset == extentOffset + off_t(extentLength)) {
+        extentLength += length;
+        return;
+    }
+    flushData();
+    flushExtent();
+    extentFd = sourceFd;
+    extentOffset = offset;
+    extentLength = length;
+}
+
+// Writes the staged data, followed by tail, in as few calls as possible.
+void PakBuilder::flushData(const char *tail, size_t tailLength)
+{
+#ifdef __WIN32
+    writeAll(fd, staging.data(), staged);
+    writeAll(fd, tail, tailLength);
+#else
+    iovec parts[2] = {{staging.data(), staged}, {const_cast<char *>(tail), tailLength}};
+    iovec *part = parts;
+    int count = 2;
+    while (count > 0) {
+        if (part->iov_len == 0) {
+            ++part;
+            --count;
+            continue;
+        }
+        auto written = ::writev(fd, part, count);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw PakException("Error writing file", std::strerror(errno));
+        }
+        while (count > 0 && size_t(written) >= part->iov_len) {
+            written -= part->iov_len;
+            ++part;
+            --count;
+        }
+        if (count > 0) {
+            part->iov_base = static_cast<char *>(part->iov_base) + written;
+            part->iov_len -= written;
+        }
+    }
+#endif
+    staged = 0;
+}
+
+void PakBuilder::flushExtent()
+{
+    if (extentLength != 0) {
+        copyExtent(extentFd, extentOffset, fd, extentLength);
+        extentLength = 0;
+    }
+}
+
+void PakBuilder::addAlias(const pakDataLabel &name, int32_t position, int32_t length)
+{
+    PakRecord record;
+    record.filename = name;
+    record.position = position;
+    record.length = length;
+    records.push_back(record);
+}
+
+bool PakBuilder::removeEntry(const pakDataLabel &name)
+{
+    auto found = std::find_if(records.begin(), records.end(), [&name](const PakRecord &x) {
+        return x.filename == name;
+    });
+    if (found == records.end()) {
+        return false;
+    }
+    records.erase(found);
+    return true;
+}
+
+int32_t PakBuilder::lastPosition() const
+{
+    return records.empty() ? PAK_HEADER_SIZE : records.back().position;
+}
+
+void PakBuilder::finish()
+{
+    const int32_t directoryLength = records.size() * DIRECTORY_ENTRY_SIZE;
+    safeAdd(dataEnd, directoryLength);
+    flushExtent();
+
+    std::vector<char> table(directoryLength);
+    char *pos = table.data();
+    for (const auto &record : records) {
+        std::copy(record.filename.begin(), record.filename.end(), pos);
+        std::memcpy(pos + PAK_DATA_LABEL_SIZE, &record.position, sizeof(int32_t));
+        std::memcpy(pos + PAK_DATA_LABEL_SIZE + sizeof(int32_t), &record.length, sizeof(int32_t));
+        pos += DIRECTORY_ENTRY_SIZE;
+    }
+    flushData(table.data(), table.size());
+
+    char header[PAK_HEADER_SIZE];
+    std::memcpy(header, "PACK", 4);
+    std::memcpy(header + 4, &dataEnd, sizeof(int32_t));
+    std::memcpy(header + 8, &directoryLength, sizeof(int32_t));
+    if (::pwrite(fd, header, PAK_HEADER_SIZE, 0) != PAK_HEADER_SIZE || (sync && syncFile(fd) != 0) ||
+        ::close(fd) != 0) {
+        fd = -1;
+        throw PakException("Error writing file", pakFile.c_str());
+    }
+    fd = -1;
+}
+
+void PakBuilder::commit()
+{
+#ifdef __WIN32
+    std::remove(pakFile.c_str()); // rename() will not replace an existing file.
+#endif
+    if (std::rename(tempFile.c_str(), pakFile.c_str()) != 0) {
+        throw PakException("Could not replace file", pakFile.c_str());
+    }
+    committed = true;
+#ifndef __WIN32
+    if (sync) { // Make the rename itself durable.
+        auto slash = pakFile.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : pakFile.substr(0, slash + 1);
+        int dirFd = ::open(directory.c_str(), O_RDONLY);
+        if (dirFd != -1) {
+            fsync(dirFd);
+            ::close(dirFd);
+        }
+    }
+#endif
+}
+
+size_t PakBuilder::size() const
+{
+    return records.size();
+}
+
+int64_t PakBuilder::bytesWritten() const
+{
+    return dataEnd;
+}
@@ -0,0 +1,96 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PAKBUILDER_H
+#define PAKBUILDER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "func.h"
+#include "pakdirectory.h"
+
+// Small entries are gathered into a buffer of this size before being written.
+const size_t WRITE_BATCH_SIZE = 1 << 20;
+
+// Writes a new PAK file front to back.  The data goes to a temporary file
+// beside the target, which only replaces the target when commit() is
+// called, so a crash never leaves a half written PAK and readers of the
+// old file keep seeing it whole.  Entry data is appended as it is
+// added, copied straight from another file where possible, and the
+// directory and header are written once at the end.  Small in memory
+// entries are batched, and extents that follow on from each other in the
+// same source are copied as one, so each write covers many entries.
+class PakBuilder
+{
+public:
+    explicit PakBuilder(const char *filename);
+    PakBuilder(const PakBuilder &other) = delete;
+    PakBuilder &operator=(const PakBuilder &other) = delete;
+    ~PakBuilder();
+
+    // Copy length bytes at offset in sourceFd into the PAK as name.
+    void addExtent(const pakDataLabel &name, int sourceFd, off_t offset, int32_t length);
+    void addData(const pakDataLabel &name, const char *data, int32_t length);
+    // Copy data without adding a directory entry.  Returns where it was written.
+    int32_t appendExtent(int sourceFd, off_t offset, int32_t length);
+    // Copy length bytes read from a stream, such as a pipe, into the PAK as name.
+    void addStream(const pakDataLabel &name, int sourceFd, int32_t length);
+    // Add name as another directory entry for data already in the PAK.
+    void addAlias(const pakDataLabel &name, int32_t position, int32_t length);
+    // Drop the directory entry for name, so a later entry can take its
+    // place.  Its data is left behind as unused space.  false if none.
+    bool removeEntry(const pakDataLabel &name);
+    int32_t lastPosition() const; // Where the data of the last entry added starts.
+    void reserve(int64_t bytes); // Preallocate the expected size of the file, where supported.
+    void setSync(bool enable); // Flush the data to disk before commit() replaces the target.
+    // Start entries of at least a block on a filesystem block boundary, so
+    // that later rewrites can share their blocks instead of copying them.
+    void setAlignment(bool enable);
+    void finish(); // Write the directory and header and close the file.
+    void commit(); // Move the finished file into place.
+    size_t size() const; // Number of entries added so far.
+    int64_t bytesWritten() const;
+private:
+    std::string pakFile;
+    std::string tempFile;
+    int fd;
+    bool sync;
+    bool committed;
+    size_t alignment;
+    int32_t dataEnd;
+    std::vector<PakRecord> records;
+    std::vector<char> staging; // Data waiting to be written.
+    size_t staged;
+    int extentFd; // Source range waiting to be copied.
+    off_t extentOffset;
+    size_t extentLength;
+
+    void addRecord(const pakDataLabel &name, int32_t length);
+    void align(int32_t length);
+    void queueData(const char *data, size_t length);
+    void queueExtent(int sourceFd, off_t offset, size_t length);
+    void flushData(const char *tail = nullptr, size_t tailLength = 0);
+    void flushExtent();
+};
+
+#endif // PAKBUILDER_H
@@ -0,0 +1,143 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "pakbuilder.h"
+#include "pakdiff.h"
+
+static void checkBounds(const PakDirectory &directory, const PakRecord &record)
+{
+    if (!directory.inBounds(record)) {
+        std::string message = record.name();
+        message += " lies outside of the file.  File is truncated or corrupt.";
+        throw PakException("File not valid", message.c_str());
+    }
+}
+
+PakDiff::PakDiff(const char *oldFilename, const char *newFilename) :
+    oldData(oldFilename), newData(newFilename), m_bytesCompared(0), sync(false)
+{
+    oldDirectory.load(oldData.data(), oldData.size());
+    newDirectory.load(newData.data(), newData.size());
+}
+
+bool PakDiff::sameContents(const PakRecord &older, const PakRecord &newer)
+{
+    checkBounds(oldDirectory, older);
+    checkBounds(newDirectory, newer);
+    m_bytesCompared += newer.length;
+    // Both files are mapped, so comparing in place stops at the first
+    // difference and never reads more than a checksum would.
+    return std::memcmp(oldData.data() + older.position, newData.data() + newer.position, newer.length) == 0;
+}
+
+int PakDiff::compare()
+{
+    // A name may be in a PAK more than once.  Each copy in the newer file
+    // is matched with the same occurrence of the name in the older one.
+    struct Copies
+    {
+        std::vector<size_t> records;
+        size_t next = 0;
+    };
+    std::unordered_map<std::string, Copies> oldNames;
+    std::vector<bool> seen(oldDirectory.size(), false);
+
+    m_changes.clear();
+    m_bytesCompared = 0;
+    for (size_t x = 0; x < oldDirectory.size(); ++x) {
+        oldNames[oldDirectory[x].name()].records.push_back(x);
+    }
+
+    for (size_t x = 0; x < newDirectory.size(); ++x) {
+        const auto &record = newDirectory[x];
+        auto name = record.name();
+        auto found = oldNames.find(name);
+        if (found == oldNames.end() || found->second.next == found->second.records.size()) {
+            m_changes.push_back(PakChange{ChangeType::Added, x, name});
+            continue;
+        }
+        auto match = found->second.records[found->second.next++];
+        seen[match] = true;
+        const auto &older = oldDirectory[match];
+        if (older.length != record.length || !sameContents(older, record)) {
+            m_changes.push_back(PakChange{ChangeType::Changed, x, name});
+        }
+    }
+
+    for (size_t x = 0; x < oldDirectory.size(); ++x) {
+        if (!seen[x]) {
+            m_changes.push_back(PakChange{ChangeType::Removed, x, oldDirectory[x].name()});
+        }
+    }
+
+    std::stable_sort(m_changes.begin(), m_changes.end(), [](const PakChange &a, const PakChange &b) {
+        return a.name < b.name;
+    });
+    return m_changes.size();
+}
+
+const std::vector<PakChange> &PakDiff::changes() const
+{
+    return m_changes;
+}
+
+void PakDiff::setSync(bool enable)
+{
+    sync = enable;
+}
+
+void PakDiff::writePatch(const char *patchFilename)
+{
+    // Copy in the order the data lies in the newer PAK so it is read sequentially.
+    std::vector<size_t> order;
+    for (const auto &change : m_changes) {
+        if (change.type != ChangeType::Removed) {
+            checkBounds(newDirectory, newDirectory[change.record]);
+            order.push_back(change.record);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return newDirectory[a].position < newDirectory[b].position;
+    });
+
+    int64_t total = PAK_HEADER_SIZE + int64_t(order.size()) * DIRECTORY_ENTRY_SIZE;
+    for (auto x : order) {
+        total += newDirectory[x].length;
+    }
+
+    PakBuilder patch(patchFilename);
+    patch.setSync(sync);
+    patch.reserve(total);
+    for (auto x : order) {
+        const auto &record = newDirectory[x];
+        patch.addExtent(record.filename, newData.fileDescriptor(), record.position, record.length);
+    }
+    patch.finish();
+    patch.commit();
+}
+
+int64_t PakDiff::bytesCompared() const
+{
+    return m_bytesCompared;
+}
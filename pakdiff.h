@@ -0,0 +1,67 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PAKDIFF_H
+#define PAKDIFF_H
+
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+#include "pakdirectory.h"
+
+enum class ChangeType {
+    Added,
+    Removed,
+    Changed
+};
+
+struct PakChange
+{
+    ChangeType type;
+    size_t record; // Index into the newer directory, or the older one for Removed.
+    std::string name;
+};
+
+// Compares two PAK files.  Directories are compared first, and the data of
+// entries is only read when an entry of the same name and size is in both.
+class PakDiff
+{
+public:
+    PakDiff(const char *oldFilename, const char *newFilename);
+
+    int compare(); // Returns the number of differences.
+    const std::vector<PakChange> &changes() const;
+    void setSync(bool enable); // Flush the patch to disk before it replaces any old one.
+    void writePatch(const char *patchFilename); // PAK of added and changed entries.
+    int64_t bytesCompared() const;
+private:
+    MappedFile oldData;
+    MappedFile newData;
+    PakDirectory oldDirectory;
+    PakDirectory newDirectory;
+    std::vector<PakChange> m_changes;
+    int64_t m_bytesCompared;
+    bool sync;
+
+    bool sameContents(const PakRecord &older, const PakRecord &newer);
+};
+
+#endif // PAKDIFF_H
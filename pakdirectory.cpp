@@ -0,0 +1,219 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "pakdirectory.h"
+
+std::string PakRecord::name() const
+{
+    auto last = std::find(filename.begin(), filename.end(), '\0');
+    return std::string(filename.begin(), last);
+}
+
+int64_t PakRecord::end() const
+{
+    return static_cast<int64_t>(position) + length;
+}
+
+
+PakDirectory::PakDirectory() : m_offset(PAK_HEADER_SIZE), m_length(0), m_fileSize(0)
+{
+
+}
+
+void PakDirectory::checkHeader(const char *header, int64_t pakSize)
+{
+    if (pakSize < PAK_HEADER_SIZE || std::memcmp(header, "PACK", 4) != 0) {
+        throw (PakException("Invalid file", "Not a valid PAK file."));
+    }
+    std::memcpy(&m_offset, header + 4, sizeof(int32_t));
+    std::memcpy(&m_length, header + 8, sizeof(int32_t));
+    m_fileSize = pakSize;
+
+    if (m_length % DIRECTORY_ENTRY_SIZE != 0 || m_length < 0) {
+        throw (PakException("File not valid", "Error reading directory.  File is corrupt or not a PAK file."));
+    }
+    if (m_offset < PAK_HEADER_SIZE || static_cast<int64_t>(m_offset) + m_length > pakSize) {
+        throw (PakException("File not valid", "Directory lies outside of the file.  File is truncated or corrupt."));
+    }
+}
+
+void PakDirectory::parse(const char *table)
+{
+    records.clear();
+    records.resize(m_length / DIRECTORY_ENTRY_SIZE);
+    for (auto &record : records) {
+        std::copy(table, table + PAK_DATA_LABEL_SIZE, record.filename.begin());
+        std::memcpy(&record.position, table + PAK_DATA_LABEL_SIZE, sizeof(int32_t));
+        std::memcpy(&record.length, table + PAK_DATA_LABEL_SIZE + sizeof(int32_t), sizeof(int32_t));
+        table += DIRECTORY_ENTRY_SIZE;
+    }
+}
+
+void PakDirectory::load(const char *pakData, size_t pakSize)
+{
+    checkHeader(pakData, pakSize);
+    parse(pakData + m_offset);
+}
+
+void PakDirectory::load(int fd)
+{
+    struct stat statbuf;
+    char header[PAK_HEADER_SIZE];
+
+    if (fstat(fd, &statbuf) != 0) {
+        throw PakException("Error loading file", std::strerror(errno));
+    }
+    if (statbuf.st_size < PAK_HEADER_SIZE || ::pread(fd, header, PAK_HEADER_SIZE, 0) != PAK_HEADER_SIZE) {
+        throw (PakException("Invalid file", "Not a valid PAK file."));
+    }
+    checkHeader(header, statbuf.st_size);
+
+    std::unique_ptr<char[]> table(new char[m_length]);
+    if (::pread(fd, table.get(), m_length, m_offset) != m_length) {
+        throw (PakException("File not valid", "Error reading directory.  File is corrupt or not a PAK file."));
+    }
+    parse(table.get());
+}
+
+int32_t PakDirectory::offset() const
+{
+    return m_offset;
+}
+
+int32_t PakDirectory::length() const
+{
+    return m_length;
+}
+
+int64_t PakDirectory::fileSize() const
+{
+    return m_fileSize;
+}
+
+size_t PakDirectory::size() const
+{
+    return records.size();
+}
+
+bool PakDirectory::inBounds(const PakRecord &record) const
+{
+    if (record.length == 0) {
+        return true; // Empty files have no data, so where they point does not matter.
+    }
+    return record.length > 0 && record.position >= PAK_HEADER_SIZE && record.end() <= m_fileSize;
+}
+
+std::vector<size_t> PakDirectory::sorted(PakOrder order) const
+{
+    std::vector<size_t> indexes(records.size());
+    for (size_t x = 0; x < indexes.size(); ++x) {
+        indexes[x] = x;
+    }
+    switch (order) {
+    case PakOrder::Offset:
+        std::stable_sort(indexes.begin(), indexes.end(), [this](size_t a, size_t b) {
+            return records[a].position < records[b].position;
+        });
+        break;
+    case PakOrder::Name:
+        std::stable_sort(indexes.begin(), indexes.end(), [this](size_t a, size_t b) {
+            return std::strncmp(records[a].filename.data(), records[b].filename.data(), PAK_DATA_LABEL_SIZE) < 0;
+        });
+        break;
+    case PakOrder::Size:
+        std::stable_sort(indexes.begin(), indexes.end(), [this](size_t a, size_t b) {
+            return records[a].length > records[b].length;
+        });
+        break;
+    case PakOrder::Directory:
+        break;
+    case PakOrder::Tree:
+        return treeOrder();
+    }
+    return indexes;
+}
+
+namespace {
+struct TreeNode
+{
+    std::vector<size_t> children; // Indexes of the directories below, in the order first seen.
+    std::vector<size_t> files; // Records in this directory.
+};
+
+void appendTree(const std::vector<TreeNode> &nodes, size_t node, std::vector<size_t> &order)
+{
+    for (auto x : nodes[node].children) {
+        appendTree(nodes, x, order);
+    }
+    order.insert(order.end(), nodes[node].files.begin(), nodes[node].files.end());
+}
+}
+
+// Each directory's subdirectories, with everything under them, then its
+// files, as walking the TreeItem hierarchy built from the table lists them.
+std::vector<size_t> PakDirectory::treeOrder() const
+{
+    std::vector<TreeNode> nodes(1);
+    std::unordered_map<std::string_view, size_t> directories; // Path including the '/' to node.
+    for (size_t x = 0; x < records.size(); ++x) {
+        const auto &filename = records[x].filename;
+        std::string_view path(filename.data(), std::find(filename.begin(), filename.end(), '\0') - filename.begin());
+        size_t node = 0;
+        for (auto slash = path.find('/'); slash != std::string_view::npos; slash = path.find('/', slash + 1)) {
+            auto found = directories.emplace(path.substr(0, slash + 1), nodes.size());
+            if (found.second) {
+                nodes[node].children.push_back(nodes.size());
+                nodes.emplace_back();
+            }
+            node = found.first->second;
+        }
+        nodes[node].files.push_back(x);
+    }
+
+    std::vector<size_t> order;
+    order.reserve(records.size());
+    appendTree(nodes, 0, order);
+    return order;
+}
+
+const PakRecord &PakDirectory::operator[](size_t index) const
+{
+    return records[index];
+}
+
+std::vector<PakRecord>::const_iterator PakDirectory::begin() const
+{
+    return records.begin();
+}
+
+std::vector<PakRecord>::const_iterator PakDirectory::end() const
+{
+    return records.end();
+}
@@ -0,0 +1,81 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PAKDIRECTORY_H
+#define PAKDIRECTORY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "func.h"
+#include "pakexception.h"
+
+// Orders entries can be listed or laid out in.
+enum class PakOrder {
+    Offset,    // As the data lies in the file.
+    Name,      // Sorted by path.
+    Size,      // Largest first.
+    Directory, // In directory table order.
+    Tree       // Grouped by directory, as the TreeItem hierarchy holds them.
+};
+
+// A single 64 byte record from the directory table of a PAK file.
+struct PakRecord
+{
+    pakDataLabel filename;
+    int32_t position;
+    int32_t length;
+
+    std::string name() const; // The file name, up to the first null.
+    int64_t end() const; // One past the last byte of the data.
+};
+
+// The directory table of a PAK file, exactly as it is stored on disk.
+// Unlike the TreeItem hierarchy, nothing is checked or merged, so this is
+// what tools that inspect or copy whole PAK files work from.
+class PakDirectory
+{
+public:
+    PakDirectory();
+
+    void load(const char *pakData, size_t pakSize); // Parse from an in memory (mapped) PAK file.
+    void load(int fd); // Read the header and directory table from a descriptor.
+    int32_t offset() const; // Position of the directory table.
+    int32_t length() const; // Size of the directory table in bytes.
+    int64_t fileSize() const;
+    size_t size() const; // Number of records.
+    bool inBounds(const PakRecord &record) const; // Whether the record's data lies within the file.
+    std::vector<size_t> sorted(PakOrder order) const; // Record indexes in the given order.
+    const PakRecord &operator[](size_t index) const;
+    std::vector<PakRecord>::const_iterator begin() const;
+    std::vector<PakRecord>::const_iterator end() const;
+private:
+    int32_t m_offset;
+    int32_t m_length;
+    int64_t m_fileSize;
+    std::vector<PakRecord> records;
+
+    void checkHeader(const char *header, int64_t pakSize);
+    void parse(const char *table);
+    std::vector<size_t> treeOrder() const;
+};
+
+#endif // PAKDIRECTORY_H
@@ -0,0 +1,185 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+
+#include "pakindex.h"
+
+// Compares paths one component at a time, by sorting '/' before every
+// other character.  Sorting the whole table this way leaves the children
+// of every directory next to each other and in name order.
+static bool pathLess(const pakDataLabel &a, const pakDataLabel &b)
+{
+    for (size_t x = 0; x < a.size(); ++x) {
+        unsigned char ca = a[x] == '/' ? 1 : a[x];
+        unsigned char cb = b[x] == '/' ? 1 : b[x];
+        if (ca != cb) {
+            return ca < cb;
+        }
+        if (ca == 0) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static int compareName(const char *a, size_t aLength, const char *b, size_t bLength)
+{
+    auto result = std::memcmp(a, b, std::min(aLength, bLength));
+    if (result != 0) {
+        return result;
+    }
+    return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
+
+PakIndex::PakIndex()
+{
+    nodes.push_back(IndexNode{0, 0, 0, 0, NO_RECORD});
+}
+
+void PakIndex::build(const PakDirectory &directory)
+{
+    struct Pending
+    {
+        uint32_t node;
+        size_t first; // Range of sorted records under this node.
+        size_t last;
+        size_t depth; // Offset of this node's children's names within the paths.
+    };
+
+    std::vector<uint32_t> sorted(directory.size());
+    for (uint32_t x = 0; x < sorted.size(); ++x) {
+        sorted[x] = x;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [&directory](uint32_t a, uint32_t b) {
+        return pathLess(directory[a].filename, directory[b].filename);
+    });
+
+    std::unordered_map<std::string, uint32_t> interned;
+    nodes.assign(1, IndexNode{0, 0, 0, 0, NO_RECORD});
+    names.clear();
+
+    // Breadth first, so each node's children are appended together.
+    std::deque<Pending> queue;
+    queue.push_back(Pending{0, 0, sorted.size(), 0});
+    while (!queue.empty()) {
+        auto pending = queue.front();
+        queue.pop_front();
+        nodes[pending.node].firstChild = nodes.size();
+
+        for (size_t x = pending.first; x < pending.last;) {
+            const auto &filename = directory[sorted[x]].filename;
+            auto start = filename.begin() + pending.depth;
+            auto nameEnd = std::find(start, filename.end(), '\0');
+            auto slash = std::find(start, nameEnd, '/');
+            std::string component(start, slash);
+
+            // Everything sharing this component, which pathLess put together.
+            size_t y = x + 1;
+            if (slash != nameEnd) {
+                while (y < pending.last) {
+                    const auto &other = directory[sorted[y]].filename;
+                    if (!std::equal(start, slash + 1, other.begin() + pending.depth)) {
+                        break;
+                    }
+                    ++y;
+                }
+            }
+
+            auto pooled = interned.find(component);
+            if (pooled == interned.end()) {
+                pooled = interned.emplace(component, names.size()).first;
+                names += component;
+            }
+            uint32_t child = nodes.size();
+            nodes.push_back(IndexNode{pooled->second, static_cast<uint32_t>(component.size()), 0, 0,
+                                      slash == nameEnd ? sorted[x] : NO_RECORD});
+            nodes[pending.node].childCount++;
+            if (slash != nameEnd) {
+                queue.push_back(Pending{child, x, y, static_cast<size_t>(slash + 1 - filename.begin())});
+            }
+            x = y;
+        }
+    }
+    nodes.shrink_to_fit();
+    names.shrink_to_fit();
+}
+
+uint32_t PakIndex::findChild(const IndexNode &parent, const char *name, size_t length) const
+{
+    auto first = nodes.begin() + parent.firstChild;
+    auto last = first + parent.childCount;
+    auto found = std::lower_bound(first, last, 0, [&](const IndexNode &x, int) {
+        return compareName(names.data() + x.nameOffset, x.nameLength, name, length) < 0;
+    });
+    if (found == last || compareName(names.data() + found->nameOffset, found->nameLength, name, length) != 0) {
+        return NO_RECORD;
+    }
+    return found - nodes.begin();
+}
+
+uint32_t PakIndex::find(std::string_view path) const
+{
+    uint32_t current = 0;
+    size_t start = 0;
+    while (start < path.size()) {
+        auto slash = path.find('/', start);
+        if (slash == std::string_view::npos) {
+            slash = path.size();
+        }
+        if (slash > start) { // Skip empty components from doubled slashes.
+            current = findChild(nodes[current], path.data() + start, slash - start);
+            if (current == NO_RECORD) {
+                return NO_RECORD;
+            }
+        }
+        start = slash + 1;
+    }
+    return current;
+}
+
+uint32_t PakIndex::findRecord(std::string_view path) const
+{
+    auto found = find(path);
+    return found == NO_RECORD ? NO_RECORD : nodes[found].record;
+}
+
+const IndexNode &PakIndex::node(uint32_t index) const
+{
+    return nodes[index];
+}
+
+std::string PakIndex::name(uint32_t index) const
+{
+    return names.substr(nodes[index].nameOffset, nodes[index].nameLength);
+}
+
+size_t PakIndex::size() const
+{
+    return nodes.size();
+}
+
+size_t PakIndex::memoryUsed() const
+{
+    return nodes.capacity() * sizeof(IndexNode) + names.capacity();
+}
@@ -0,0 +1,68 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PAKINDEX_H
+#define PAKINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pakdirectory.h"
+
+const uint32_t NO_RECORD = 0xffffffff;
+
+// One directory or file in a PakIndex.  Names are offsets into the shared
+// name pool, and the children of a node are stored next to each other,
+// sorted by name.
+struct IndexNode
+{
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t record; // Directory record of a file, or NO_RECORD for a directory.
+};
+
+// Read only index of the paths in a PAK file.  All nodes live in one array
+// and all names in one string, each stored once however often it is used,
+// so lookups touch a few cache lines rather than a tree of heap objects.
+// Built in one pass over the directory table.
+class PakIndex
+{
+public:
+    PakIndex();
+
+    void build(const PakDirectory &directory);
+    uint32_t find(std::string_view path) const; // Node for a path, or NO_RECORD.
+    uint32_t findRecord(std::string_view path) const; // Directory record for a file path, or NO_RECORD.
+    const IndexNode &node(uint32_t index) const; // Node 0 is the root.
+    std::string name(uint32_t index) const;
+    size_t size() const;
+    size_t memoryUsed() const;
+private:
+    std::vector<IndexNode> nodes;
+    std::string names;
+
+    uint32_t findChild(const IndexNode &parent, const char *name, size_t length) const;
+};
+
+#endif // PAKINDEX_H
@@ -0,0 +1,344 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "extentcopy.h"
+#include "paklist.h"
+
+// Output is written whenever the buffer passes this size.
+static const size_t LIST_BUFFER_SIZE = 1 << 20;
+
+PakLister::PakLister(const PakDirectory &directory) :
+    m_directory(directory), m_format(ListFormat::Text), m_order(PakOrder::Tree),
+    m_showOffset(false), m_summary(false), m_typeTotals(false), m_types(nullptr), fd(-1)
+{
+
+}
+
+void PakLister::setFormat(ListFormat format)
+{
+    m_format = format;
+}
+
+void PakLister::setOrder(PakOrder order)
+{
+    m_order = order;
+}
+
+void PakLister::setShowOffset(bool show)
+{
+    m_showOffset = show;
+}
+
+void PakLister::setSummary(bool summary)
+{
+    m_summary = summary;
+}
+
+void PakLister::setFilter(const PakTypes *types, const TypeFilter &filter)
+{
+    m_types = types;
+    m_filter = filter;
+}
+
+void PakLister::setTypeTotals(bool totals)
+{
+    m_typeTotals = totals;
+}
+
+bool PakLister::matches(size_t record) const
+{
+    if (m_types == nullptr) {
+        return true;
+    }
+    return m_filter.matches(m_types->type(record), m_directory[record].length);
+}
+
+void PakLister::flushIfFull()
+{
+    if (buffer.size() >= LIST_BUFFER_SIZE) {
+        writeAll(fd, buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
+
+// Quotes a name for JSON or CSV.  Text and null separated output is raw.
+// Names are not necessarily UTF-8, so for JSON bytes above 0x7f are taken
+// as Latin-1 and escaped, which keeps the output valid whatever they are.
+void PakLister::appendQuoted(const char *text, size_t length)
+{
+    buffer += '"';
+    for (size_t x = 0; x < length; ++x) {
+        unsigned char c = text[x];
+        if (m_format == ListFormat::Csv) {
+            if (c == '"') {
+                buffer += '"';
+            }
+            buffer += c;
+        } else if (c == '"' || c == '\\') {
+            buffer += '\\';
+            buffer += c;
+        } else if (c < 0x20 || c >= 0x80) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            buffer += escape;
+        } else {
+            buffer += c;
+        }
+    }
+    buffer += '"';
+}
+
+void PakLister::appendLine(const char *name, size_t nameLength, int64_t size,
+                           int64_t offset, int64_t files)
+{
+    switch (m_format) {
+    case ListFormat::Text:
+        buffer.append(name, nameLength);
+        buffer += '\t';
+        if (files >= 0) {
+            buffer += std::to_string(files);
+            buffer += " files\t";
+        }
+        buffer += std::to_string(size);
+        buffer += " bytes.";
+        if (offset >= 0) {
+            buffer += "\tat ";
+            buffer += std::to_string(offset);
+        }
+        buffer += '\n';
+        break;
+    case ListFormat::Json:
+        buffer += files >= 0 ? (m_typeTotals ? "{\"type\":" : "{\"directory\":") : "{\"name\":";
+        appendQuoted(name, nameLength);
+        if (files >= 0) {
+            buffer += ",\"files\":";
+            buffer += std::to_string(files);
+        }
+        buffer += ",\"size\":";
+        buffer += std::to_string(size);
+        if (offset >= 0) {
+            buffer += ",\"offset\":";
+            buffer += std::to_string(offset);
+        }
+        buffer += "}\n";
+        break;
+    case ListFormat::Csv:
+        appendQuoted(name, nameLength);
+        if (files >= 0) {
+            buffer += ',';
+            buffer += std::to_string(files);
+        }
+        buffer += ',';
+        buffer += std::to_string(size);
+        if (offset >= 0) {
+            buffer += ',';
+            buffer += std::to_string(offset);
+        }
+        buffer += '\n';
+        break;
+    case ListFormat::Nul:
+        buffer.append(name, nameLength);
+        buffer += '\0';
+        break;
+    }
+    flushIfFull();
+}
+
+void PakLister::writeFiles()
+{
+    if (m_format == ListFormat::Csv) {
+        buffer += m_showOffset ? "name,size,offset\n" : "name,size\n";
+    }
+    for (auto x : m_directory.sorted(m_order)) {
+        if (!matches(x)) {
+            continue;
+        }
+        const auto &record = m_directory[x];
+        auto nameEnd = std::find(record.filename.begin(), record.filename.end(), '\0');
+        appendLine(record.filename.data(), nameEnd - record.filename.begin(), record.length,
+                   m_showOffset ? record.position : -1, -1);
+    }
+}
+
+// Totals for every directory, including everything below it, like du.
+void PakLister::writeSummary()
+{
+    struct Total
+    {
+        int64_t files;
+        int64_t size;
+    };
+    std::map<std::string, Total> totals;
+
+    for (size_t x = 0; x < m_directory.size(); ++x) {
+        if (!matches(x)) {
+            continue;
+        }
+        const auto &record = m_directory[x];
+        auto name = record.name();
+        totals["/"].files++;
+        totals["/"].size += record.length;
+        for (auto slash = name.find('/'); slash != std::string::npos; slash = name.find('/', slash + 1)) {
+            auto &total = totals[name.substr(0, slash + 1)];
+            total.files++;
+            total.size += record.length;
+        }
+    }
+
+    std::vector<std::map<std::string, Total>::const_iterator> order;
+    for (auto x = totals.cbegin(); x != totals.cend(); ++x) {
+        order.push_back(x);
+    }
+    if (m_order == PakOrder::Size) {
+        std::stable_sort(order.begin(), order.end(), [](std::map<std::string, Total>::const_iterator a,
+                                                       std::map<std::string, Total>::const_iterator b) {
+            return a->second.size > b->second.size;
+        });
+    }
+
+    if (m_format == ListFormat::Csv) {
+        buffer += "directory,files,size\n";
+    }
+    for (const auto &x : order) {
+        appendLine(x->first.data(), x->first.size(), x->second.size, -1, x->second.files);
+    }
+}
+
+void PakLister::writeTypeTotals()
+{
+    std::array<TypeTotal, FILE_TYPE_COUNT> totals;
+    for (int x = 0; x < FILE_TYPE_COUNT; ++x) {
+        totals[x] = m_types->total(fileTypes(x));
+    }
+    if (m_filter.isActive()) { // The classification's totals are for every entry.
+        totals.fill(TypeTotal{0, 0});
+        for (size_t x = 0; x < m_directory.size(); ++x) {
+            if (matches(x)) {
+                auto &total = totals[int(m_types->type(x))];
+                total.files++;
+                total.bytes += m_directory[x].length;
+            }
+        }
+    }
+
+    appendTypeTotals(totals);
+}
+
+void PakLister::appendTypeTotals(const std::array<TypeTotal, FILE_TYPE_COUNT> &totals)
+{
+    std::vector<int> order;
+    for (int x = 0; x < FILE_TYPE_COUNT; ++x) {
+        if (totals[x].files > 0) {
+            order.push_back(x);
+        }
+    }
+    if (m_order == PakOrder::Size) {
+        std::stable_sort(order.begin(), order.end(), [&totals](int a, int b) {
+            return totals[a].bytes > totals[b].bytes;
+        });
+    }
+
+    if (m_format == ListFormat::Csv) {
+        buffer += "type,files,size\n";
+    }
+    for (auto x : order) {
+        const char *name = PakTypes::name(fileTypes(x));
+        appendLine(name, std::strlen(name), totals[x].bytes, -1, totals[x].files);
+    }
+}
+
+void PakLister::write(int outFd)
+{
+    fd = outFd;
+    buffer.clear();
+    buffer.reserve(LIST_BUFFER_SIZE + PAK_DATA_LABEL_SIZE * 4);
+    if (m_typeTotals) {
+        writeTypeTotals();
+    } else if (m_summary) {
+        writeSummary();
+    } else {
+        writeFiles();
+    }
+    writeAll(fd, buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+void PakLister::writeWad(int outFd, const std::string &wadPath, const WadArchive &wad, int64_t wadOffset)
+{
+    fd = outFd;
+    buffer.clear();
+    std::vector<const WadLump *> lumps;
+    std::array<TypeTotal, FILE_TYPE_COUNT> totals;
+    totals.fill(TypeTotal{0, 0});
+    for (const auto &lump : wad.lumps()) {
+        auto type = wad.type(lump);
+        if (!m_filter.matches(type, lump.diskSize)) {
+            continue;
+        }
+        totals[int(type)].files++;
+        totals[int(type)].bytes += lump.diskSize;
+        lumps.push_back(&lump);
+    }
+    if (m_typeTotals) {
+        appendTypeTotals(totals);
+        writeAll(fd, buffer.data(), buffer.size());
+        buffer.clear();
+        return;
+    }
+    switch (m_order) {
+    case PakOrder::Offset:
+        std::stable_sort(lumps.begin(), lumps.end(), [](const WadLump *a, const WadLump *b) {
+            return a->position < b->position;
+        });
+        break;
+    case PakOrder::Name:
+        std::stable_sort(lumps.begin(), lumps.end(), [](const WadLump *a, const WadLump *b) {
+            return a->name < b->name;
+        });
+        break;
+    case PakOrder::Size:
+        std::stable_sort(lumps.begin(), lumps.end(), [](const WadLump *a, const WadLump *b) {
+            return a->diskSize > b->diskSize;
+        });
+        break;
+    case PakOrder::Directory:
+    case PakOrder::Tree:
+        break;
+    }
+
+    if (m_format == ListFormat::Csv) {
+        buffer += m_showOffset ? "name,size,offset\n" : "name,size\n";
+    }
+    std::string name;
+    for (const auto *lump : lumps) {
+        name = wadPath;
+        name += '/';
+        name += lump->name;
+        appendLine(name.data(), name.size(), lump->diskSize, m_showOffset ? wadOffset + lump->position : -1, -1);
+    }
+    writeAll(fd, buffer.data(), buffer.size());
+    buffer.clear();
+}
@@ -0,0 +1,82 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PAKLIST_H
+#define PAKLIST_H
+
+#include <cstdint>
+#include <string>
+
+#include "pakdirectory.h"
+#include "paktypes.h"
+#include "wadarchive.h"
+
+enum class ListFormat {
+    Text,  // name<tab>size bytes.
+    Json,  // One JSON object per line.
+    Csv,   // With a header line.
+    Nul    // Names only, each followed by a null, for xargs -0.
+};
+
+// Lists the contents of a PAK file straight from its directory table.
+// Output is built in one large buffer and written in big blocks, so
+// listing a PAK with a million entries takes a handful of system calls.
+class PakLister
+{
+public:
+    explicit PakLister(const PakDirectory &directory);
+
+    void setFormat(ListFormat format);
+    void setOrder(PakOrder order);
+    void setShowOffset(bool show);
+    void setSummary(bool summary); // List directories with their total size instead of files.
+    // Only list entries matching filter.  types must be classified from
+    // the same directory, and is needed for filtering and type totals.
+    void setFilter(const PakTypes *types, const TypeFilter &filter);
+    void setTypeTotals(bool totals); // List every type with the number and size of its files instead of files.
+    void write(int outFd);
+    // List the lumps of a WAD inside the PAK file, named wadPath/lump so
+    // they can be passed back to -c.  wadOffset is where the WAD starts.
+    // Lumps are typed from the WAD directory for the filter and totals.
+    void writeWad(int outFd, const std::string &wadPath, const WadArchive &wad, int64_t wadOffset);
+private:
+    const PakDirectory &m_directory;
+    ListFormat m_format;
+    PakOrder m_order;
+    bool m_showOffset;
+    bool m_summary;
+    bool m_typeTotals;
+    const PakTypes *m_types;
+    TypeFilter m_filter;
+    std::string buffer;
+    int fd;
+
+    void flushIfFull();
+    void appendQuoted(const char *text, size_t length);
+    void appendLine(const char *name, size_t nameLength, int64_t size,
+                    int64_t offset, int64_t files);
+    void writeFiles();
+    void writeSummary();
+    void writeTypeTotals();
+    void appendTypeTotals(const std::array<TypeTotal, FILE_TYPE_COUNT> &totals);
+    bool matches(size_t record) const;
+};
+
+#endif // PAKLIST_H
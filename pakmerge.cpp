@@ -0,0 +1,205 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <sys/stat.h>
+
+#include "crc32c.h"
+#include "pakbuilder.h"
+#include "pakmerge.h"
+
+PakMerge::PakMerge() :
+    conflictPolicy(ConflictPolicy::LastWins), deduplicate(false), sync(false), alignment(false), m_replaced(0), m_bytesSaved(0)
+{
+
+}
+
+void PakMerge::addSource(const char *filename)
+{
+    std::unique_ptr<Source> source(new Source);
+    source->filename = filename;
+    source->data.open(filename);
+    source->directory.load(source->data.data(), source->data.size());
+    for (const auto &x : source->directory) {
+        if (!source->directory.inBounds(x)) {
+            std::string message = filename;
+            message += " : " + x.name() + " lies outside of the file.";
+            throw PakException("File not valid", message.c_str());
+        }
+    }
+    sources.push_back(std::move(source));
+}
+
+void PakMerge::setConflictPolicy(ConflictPolicy policy)
+{
+    conflictPolicy = policy;
+}
+
+void PakMerge::setDeduplicate(bool dedup)
+{
+    deduplicate = dedup;
+}
+
+void PakMerge::setSync(bool enable)
+{
+    sync = enable;
+}
+
+void PakMerge::setAlignment(bool enable)
+{
+    alignment = enable;
+}
+
+const PakRecord &PakMerge::record(const Selection &selection) const
+{
+    return sources[selection.source]->directory[selection.record];
+}
+
+const char *PakMerge::contents(const Selection &selection) const
+{
+    return sources[selection.source]->data.data() + record(selection).position;
+}
+
+void PakMerge::buildDirectory()
+{
+    std::unordered_map<std::string, size_t> names;
+
+    merged.clear();
+    m_replaced = 0;
+    for (size_t s = 0; s < sources.size(); ++s) {
+        const auto &directory = sources[s]->directory;
+        for (size_t r = 0; r < directory.size(); ++r) {
+            Selection selection{s, r};
+            auto found = names.find(directory[r].name());
+            if (found == names.end()) {
+                names.emplace(directory[r].name(), merged.size());
+                merged.push_back(selection);
+                continue;
+            }
+
+            auto &existing = merged[found->second];
+            const auto &older = record(existing);
+            const auto &newer = directory[r];
+            // The contents only matter when a difference is an error.  A
+            // replaced entry is otherwise never read at all.
+            if (conflictPolicy == ConflictPolicy::Fail &&
+                (older.length != newer.length ||
+                 std::memcmp(contents(existing), contents(selection), newer.length) != 0)) {
+                std::string message = newer.name();
+                message += " in " + sources[s]->filename + " differs from " + sources[existing.source]->filename;
+                throw PakException("Conflicting entry", message.c_str());
+            }
+            existing = selection;
+            ++m_replaced;
+        }
+    }
+}
+
+void PakMerge::write(const char *outputFilename)
+{
+    struct stat output;
+    if (stat(outputFilename, &output) == 0) {
+        for (const auto &source : sources) {
+            struct stat input;
+            if (fstat(source->data.fileDescriptor(), &input) == 0 &&
+                input.st_dev == output.st_dev && input.st_ino == output.st_ino) {
+                throw PakException("Invalid output file", "The output file cannot also be one of the PAK files being merged.");
+            }
+        }
+    }
+
+    buildDirectory();
+
+    // Write each source's entries in the order they lie in that source so
+    // every input is read front to back.
+    std::vector<Selection> order(merged);
+    std::sort(order.begin(), order.end(), [this](const Selection &a, const Selection &b) {
+        if (a.source != b.source) {
+            return a.source < b.source;
+        }
+        return record(a).position < record(b).position;
+    });
+
+    // When deduplicating, entries are only checksummed if another entry
+    // has the same length, and matches are confirmed byte for byte.
+    std::map<int32_t, int> lengthCount;
+    if (deduplicate) {
+        for (const auto &x : order) {
+            lengthCount[record(x).length]++;
+        }
+    }
+    struct Written
+    {
+        Selection selection;
+        int32_t position;
+    };
+    std::multimap<std::pair<int32_t, uint32_t>, Written> written;
+
+    m_bytesSaved = 0;
+    PakBuilder builder(outputFilename);
+    builder.setSync(sync);
+    builder.setAlignment(alignment);
+    if (!deduplicate) { // Otherwise the size is not known until the end.
+        int64_t total = PAK_HEADER_SIZE + int64_t(order.size()) * DIRECTORY_ENTRY_SIZE;
+        for (const auto &x : order) {
+            total += record(x).length;
+        }
+        builder.reserve(total);
+    }
+    for (const auto &x : order) {
+        const auto &entry = record(x);
+        if (deduplicate && entry.length > 0 && lengthCount[entry.length] > 1) {
+            auto key = std::make_pair(entry.length, crc32c(0, contents(x), entry.length));
+            auto range = written.equal_range(key);
+            auto match = std::find_if(range.first, range.second, [&](const std::pair<const std::pair<int32_t, uint32_t>, Written> &w) {
+                return std::memcmp(contents(w.second.selection), contents(x), entry.length) == 0;
+            });
+            if (match != range.second) {
+                builder.addAlias(entry.filename, match->second.position, entry.length);
+                m_bytesSaved += entry.length;
+                continue;
+            }
+            builder.addExtent(entry.filename, sources[x.source]->data.fileDescriptor(), entry.position, entry.length);
+            written.emplace(key, Written{x, builder.lastPosition()});
+            continue;
+        }
+        builder.addExtent(entry.filename, sources[x.source]->data.fileDescriptor(), entry.position, entry.length);
+    }
+    builder.finish();
+    builder.commit();
+}
+
+size_t PakMerge::size() const
+{
+    return merged.size();
+}
+
+size_t PakMerge::replaced() const
+{
+    return m_replaced;
+}
+
+int64_t PakMerge::bytesSaved() const
+{
+    return m_bytesSaved;
+}
@@ -0,0 +1,80 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PAKMERGE_H
+#define PAKMERGE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+#include "pakdirectory.h"
+
+enum class ConflictPolicy {
+    LastWins, // An entry in a later PAK replaces one of the same name.
+    Fail      // Entries of the same name but different contents are an error.
+};
+
+// Combines several PAK files into one.  The merged directory is built in
+// memory and entry data is copied from each source straight into the output.
+class PakMerge
+{
+public:
+    PakMerge();
+
+    void addSource(const char *filename);
+    void setConflictPolicy(ConflictPolicy policy);
+    void setDeduplicate(bool dedup); // Store identical contents only once.
+    void setSync(bool enable); // Flush the merged file to disk before it replaces any old one.
+    void setAlignment(bool enable); // Start larger entries on filesystem block boundaries.
+    void write(const char *outputFilename);
+    size_t size() const; // Entries in the merged PAK.
+    size_t replaced() const; // Entries overridden by a later source.
+    int64_t bytesSaved() const; // Bytes not written thanks to deduplication.
+private:
+    struct Source
+    {
+        std::string filename;
+        MappedFile data;
+        PakDirectory directory;
+    };
+    struct Selection
+    {
+        size_t source;
+        size_t record;
+    };
+
+    std::vector<std::unique_ptr<Source>> sources;
+    std::vector<Selection> merged;
+    ConflictPolicy conflictPolicy;
+    bool deduplicate;
+    bool sync;
+    bool alignment;
+    size_t m_replaced;
+    int64_t m_bytesSaved;
+
+    void buildDirectory();
+    const PakRecord &record(const Selection &selection) const;
+    const char *contents(const Selection &selection) const;
+};
+
+#endif // PAKMERGE_H
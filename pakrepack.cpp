@@ -0,0 +1,160 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "pakbuilder.h"
+#include "pakrepack.h"
+
+PakRepack::PakRepack(const char *filename) :
+    pakFile(filename), order(PakOrder::Offset), m_liveBytes(0), sync(false), alignment(false)
+{
+    pakData.open(filename);
+    directory.load(pakData.data(), pakData.size());
+    findExtents();
+}
+
+void PakRepack::findExtents()
+{
+    std::vector<size_t> byOffset;
+    for (size_t x = 0; x < directory.size(); ++x) {
+        if (!directory.inBounds(directory[x])) {
+            std::string message = directory[x].name();
+            message += " lies outside of the file.  Use -k to check the file.";
+            throw PakException("File not valid", message.c_str());
+        }
+        if (directory[x].length > 0) {
+            byOffset.push_back(x);
+        }
+    }
+    std::sort(byOffset.begin(), byOffset.end(), [this](size_t a, size_t b) {
+        return directory[a].position < directory[b].position;
+    });
+
+    extents.clear();
+    m_liveBytes = 0;
+    for (auto x : byOffset) {
+        const auto &record = directory[x];
+        if (extents.empty() || record.position >= extents.back().end) {
+            extents.push_back(Extent{record.position, record.position, {}});
+        }
+        auto &extent = extents.back();
+        extent.end = std::max<int32_t>(extent.end, record.end());
+        extent.records.push_back(x);
+    }
+    for (const auto &extent : extents) {
+        m_liveBytes += extent.end - extent.start;
+    }
+}
+
+void PakRepack::sortExtents()
+{
+    // Extents are already in offset order.  For other orders, each extent
+    // goes where the first of its entries would.  Traced entries come
+    // before all others.
+    if (order == PakOrder::Offset && trace.empty()) {
+        return;
+    }
+    std::vector<size_t> rank(directory.size());
+    auto sorted = directory.sorted(order);
+    for (size_t x = 0; x < sorted.size(); ++x) {
+        rank[sorted[x]] = trace.size() + x;
+    }
+    if (!trace.empty()) {
+        std::unordered_map<std::string, size_t> traceRank;
+        for (size_t x = 0; x < trace.size(); ++x) {
+            traceRank.emplace(trace[x], x);
+        }
+        for (size_t x = 0; x < directory.size(); ++x) {
+            auto found = traceRank.find(directory[x].name());
+            if (found != traceRank.end()) {
+                rank[x] = found->second;
+            }
+        }
+    }
+    for (auto &extent : extents) {
+        std::sort(extent.records.begin(), extent.records.end(), [&rank](size_t a, size_t b) {
+            return rank[a] < rank[b];
+        });
+    }
+    std::stable_sort(extents.begin(), extents.end(), [&rank](const Extent &a, const Extent &b) {
+        return rank[a.records.front()] < rank[b.records.front()];
+    });
+}
+
+void PakRepack::setOrder(PakOrder newOrder)
+{
+    order = newOrder;
+}
+
+void PakRepack::setTrace(const stringList &paths)
+{
+    trace = paths;
+}
+
+void PakRepack::setSync(bool enable)
+{
+    sync = enable;
+}
+
+void PakRepack::setAlignment(bool enable)
+{
+    alignment = enable;
+}
+
+int64_t PakRepack::liveBytes() const
+{
+    return m_liveBytes;
+}
+
+int64_t PakRepack::wastedBytes() const
+{
+    return directory.fileSize() - PAK_HEADER_SIZE - directory.length() - m_liveBytes;
+}
+
+size_t PakRepack::extentCount() const
+{
+    return extents.size();
+}
+
+void PakRepack::write(const char *outputFilename)
+{
+    // PakBuilder writes to a temporary file, so repacking in place is safe
+    // even though the old data is read while the new file is written.
+    sortExtents();
+    std::vector<int32_t> newPosition(directory.size(), PAK_HEADER_SIZE);
+    PakBuilder builder(outputFilename);
+    builder.setSync(sync);
+    builder.setAlignment(alignment);
+    builder.reserve(PAK_HEADER_SIZE + m_liveBytes + int64_t(directory.size()) * DIRECTORY_ENTRY_SIZE);
+    for (const auto &extent : extents) {
+        auto start = builder.appendExtent(pakData.fileDescriptor(), extent.start, extent.end - extent.start);
+        for (auto x : extent.records) {
+            newPosition[x] = start + (directory[x].position - extent.start);
+        }
+    }
+    // The directory keeps its original order.
+    for (size_t x = 0; x < directory.size(); ++x) {
+        builder.addAlias(directory[x].filename, newPosition[x], directory[x].length);
+    }
+    builder.finish();
+    builder.commit();
+}
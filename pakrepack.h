@@ -0,0 +1,70 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PAKREPACK_H
+#define PAKREPACK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+#include "pakdirectory.h"
+
+// Rewrites a PAK file without the unused space between entries.  Entries
+// whose data overlaps are kept sharing it.  Data is copied straight from
+// the old file, so memory use does not depend on the size of the PAK.
+class PakRepack
+{
+public:
+    explicit PakRepack(const char *filename);
+
+    void setOrder(PakOrder order);
+    void setTrace(const stringList &paths); // Entries to place first, in this order, before the rest in the set order.
+    void setSync(bool enable); // Flush the new file to disk before it replaces the old one.
+    void setAlignment(bool enable); // Start larger extents on filesystem block boundaries.
+    int64_t liveBytes() const; // Bytes used by entry data.
+    int64_t wastedBytes() const; // Bytes used by neither entry data, the header nor the directory.
+    size_t extentCount() const;
+    void write(const char *outputFilename);
+private:
+    // A run of bytes used by one or more overlapping entries.
+    struct Extent
+    {
+        int32_t start;
+        int32_t end;
+        std::vector<size_t> records;
+    };
+
+    std::string pakFile;
+    MappedFile pakData;
+    PakDirectory directory;
+    std::vector<Extent> extents;
+    PakOrder order;
+    stringList trace;
+    int64_t m_liveBytes;
+    bool sync;
+    bool alignment;
+
+    void findExtents();
+    void sortExtents();
+};
+
+#endif // PAKREPACK_H
@@ -0,0 +1,340 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "extentcopy.h"
+#include "pakbuilder.h"
+#include "paktar.h"
+
+// The fields of a POSIX ustar header block.
+struct TarHeader
+{
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char padding[12];
+};
+static_assert(sizeof(TarHeader) == TAR_BLOCK_SIZE, "tar header must be one block");
+
+static void writeOctal(char *field, size_t width, uint64_t value)
+{
+    std::snprintf(field, width, "%0*llo", int(width - 1), static_cast<unsigned long long>(value));
+}
+
+static uint64_t readNumber(const char *field, size_t width)
+{
+    uint64_t value = 0;
+    if (static_cast<unsigned char>(field[0]) & 0x80) { // GNU base 256, for large sizes.
+        value = field[0] & 0x7f;
+        for (size_t x = 1; x < width; ++x) {
+            value = (value << 8) | static_cast<unsigned char>(field[x]);
+        }
+        return value;
+    }
+    for (size_t x = 0; x < width && field[x] != '\0'; ++x) {
+        if (field[x] >= '0' && field[x] <= '7') {
+            value = value * 8 + (field[x] - '0');
+        }
+    }
+    return value;
+}
+
+static unsigned int headerChecksum(const TarHeader &header)
+{
+    // The checksum field itself counts as spaces.
+    const auto *bytes = reinterpret_cast<const unsigned char *>(&header);
+    unsigned int sum = 0;
+    for (size_t x = 0; x < sizeof(header); ++x) {
+        bool inChecksum = x >= offsetof(TarHeader, checksum) && x < offsetof(TarHeader, checksum) + sizeof(header.checksum);
+        sum += inChecksum ? ' ' : bytes[x];
+    }
+    return sum;
+}
+
+static size_t paddingFor(uint64_t length)
+{
+    return (TAR_BLOCK_SIZE - length % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+}
+
+TarExporter::TarExporter(const char *pakFilename) :
+    pakFile(pakFilename)
+{
+    pakFd = ::open(pakFilename, O_RDONLY);
+    if (pakFd == -1) {
+        throw PakException("Could not open file", pakFilename);
+    }
+    try {
+        directory.load(pakFd);
+    } catch (PakException &) {
+        ::close(pakFd);
+        throw;
+    }
+}
+
+TarExporter::~TarExporter()
+{
+    ::close(pakFd);
+}
+
+void TarExporter::write(int outFd)
+{
+    struct stat statbuf;
+    fstat(pakFd, &statbuf);
+    const char zeros[TAR_BLOCK_SIZE] = {};
+
+    for (auto x : directory.sorted(PakOrder::Offset)) {
+        const auto &record = directory[x];
+        if (!directory.inBounds(record)) {
+            std::string message = record.name();
+            message += " lies outside of the file.  Use -k to check the file.";
+            throw PakException("File not valid", message.c_str());
+        }
+        TarHeader header;
+        std::memset(&header, 0, sizeof(header));
+        auto name = record.name();
+        std::copy(name.begin(), name.end(), header.name); // PAK names always fit.
+        writeOctal(header.mode, sizeof(header.mode), 0644);
+        writeOctal(header.uid, sizeof(header.uid), 0);
+        writeOctal(header.gid, sizeof(header.gid), 0);
+        writeOctal(header.size, sizeof(header.size), record.length);
+        writeOctal(header.mtime, sizeof(header.mtime), statbuf.st_mtime);
+        header.typeflag = '0';
+        std::memcpy(header.magic, "ustar", 6);
+        std::memcpy(header.version, "00", 2);
+        std::snprintf(header.checksum, sizeof(header.checksum), "%06o", headerChecksum(header));
+        header.checksum[7] = ' ';
+
+        writeAll(outFd, reinterpret_cast<const char *>(&header), sizeof(header));
+        copyExtent(pakFd, record.position, outFd, record.length);
+        writeAll(outFd, zeros, paddingFor(record.length));
+    }
+    // The end of the archive is marked by two empty blocks.
+    writeAll(outFd, zeros, TAR_BLOCK_SIZE);
+    writeAll(outFd, zeros, TAR_BLOCK_SIZE);
+}
+
+// Reads exactly length bytes from a stream.  Returns false if it has
+// already ended, and throws if it ends part way.
+static bool readStream(int fd, char *buffer, size_t length)
+{
+    auto wanted = length;
+    while (length > 0) {
+        auto got = ::read(fd, buffer, length);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw PakException("Error reading tar stream", std::strerror(errno));
+        }
+        if (got == 0) {
+            if (length == wanted) {
+                return false;
+            }
+            throw PakException("Error reading tar stream", "Unexpected end of input.");
+        }
+        buffer += got;
+        length -= got;
+    }
+    return true;
+}
+
+// Reads a tar entry's data into a string.  Used for long names and pax
+// headers, which are small.
+static std::string readString(int fd, uint64_t length)
+{
+    if (length > (1 << 20)) {
+        throw PakException("Error reading tar stream", "Extended header too large.");
+    }
+    std::string data(length + paddingFor(length), '\0');
+    if (!readStream(fd, &data[0], data.size())) {
+        throw PakException("Error reading tar stream", "Unexpected end of input.");
+    }
+    data.resize(length);
+    return data;
+}
+
+static void skipStream(int fd, uint64_t length)
+{
+    char buffer[TAR_BLOCK_SIZE];
+    while (length > 0) {
+        auto chunk = std::min<uint64_t>(length, sizeof(buffer));
+        if (!readStream(fd, buffer, chunk)) {
+            throw PakException("Error reading tar stream", "Unexpected end of input.");
+        }
+        length -= chunk;
+    }
+}
+
+// Finds the path in a pax extended header, a list of "length key=value\n" records.
+static std::string paxPath(const std::string &records)
+{
+    size_t pos = 0;
+    while (pos < records.size()) {
+        auto space = records.find(' ', pos);
+        if (space == std::string::npos) {
+            break;
+        }
+        auto length = std::strtoul(records.c_str() + pos, nullptr, 10);
+        if (length == 0 || pos + length > records.size()) {
+            break;
+        }
+        auto record = records.substr(space + 1, pos + length - space - 2); // Without the newline.
+        if (record.compare(0, 5, "path=") == 0) {
+            return record.substr(5);
+        }
+        pos += length;
+    }
+    return std::string();
+}
+
+TarImporter::TarImporter(const char *pakFilename) :
+    pakFile(pakFilename), verbose(false), sync(false), align(false), m_size(0), m_skipped(0), m_replaced(0)
+{
+
+}
+
+void TarImporter::setVerbose(bool verbosity)
+{
+    verbose = verbosity;
+}
+
+void TarImporter::setSync(bool enable)
+{
+    sync = enable;
+}
+
+void TarImporter::setAlignment(bool enable)
+{
+    align = enable;
+}
+
+void TarImporter::read(int inFd)
+{
+    PakBuilder builder(pakFile.c_str());
+    builder.setSync(sync);
+    builder.setAlignment(align);
+    std::string longName; // From a GNU long name or pax header, for the next entry.
+    std::unordered_set<std::string> names;
+    m_size = 0;
+    m_skipped = 0;
+    m_replaced = 0;
+
+    TarHeader header;
+    while (readStream(inFd, reinterpret_cast<char *>(&header), sizeof(header))) {
+        if (header.name[0] == '\0') { // End of archive.
+            break;
+        }
+        if (readNumber(header.checksum, sizeof(header.checksum)) != headerChecksum(header)) {
+            throw PakException("Error reading tar stream", "Bad header checksum.  Not a tar stream?");
+        }
+        auto length = readNumber(header.size, sizeof(header.size));
+
+        if (header.typeflag == 'L') {
+            longName = readString(inFd, length);
+            longName.resize(std::strlen(longName.c_str()));
+            continue;
+        }
+        if (header.typeflag == 'x') {
+            longName = paxPath(readString(inFd, length));
+            continue;
+        }
+        if (header.typeflag != '0' && header.typeflag != '\0' && header.typeflag != '7') {
+            skipStream(inFd, length + paddingFor(length));
+            ++m_skipped;
+            longName.clear();
+            continue;
+        }
+
+        std::string path = longName;
+        longName.clear();
+        if (path.empty()) {
+            if (header.prefix[0] != '\0' && std::memcmp(header.magic, "ustar", 5) == 0) {
+                path.assign(header.prefix, strnlen(header.prefix, sizeof(header.prefix)));
+                path += '/';
+            }
+            path.append(header.name, strnlen(header.name, sizeof(header.name)));
+        }
+        while (path.compare(0, 2, "./") == 0) {
+            path.erase(0, 2);
+        }
+        path.erase(0, path.find_first_not_of('/'));
+        if (path.size() > size_t(PAK_DATA_LABEL_SIZE - 1)) {
+            throw PakException("Path name too long", path.c_str());
+        }
+        if (length > uint64_t(INT32_MAX)) {
+            throw PakException("File too large.", path.c_str());
+        }
+
+        pakDataLabel label;
+        label.fill('\0');
+        std::copy(path.begin(), path.end(), label.begin());
+        bool replacing = !names.insert(path).second && builder.removeEntry(label);
+        builder.addStream(label, inFd, length);
+        skipStream(inFd, paddingFor(length));
+        if (replacing) {
+            ++m_replaced;
+        } else {
+            ++m_size;
+        }
+#ifdef CLI
+        if (verbose) {
+            std::cout << (replacing ? "Replacing " : "") << path << "\t" << length << " bytes \n";
+        }
+#endif
+    }
+    builder.finish();
+    builder.commit();
+}
+
+size_t TarImporter::size() const
+{
+    return m_size;
+}
+
+size_t TarImporter::skipped() const
+{
+    return m_skipped;
+}
+
+size_t TarImporter::replaced() const
+{
+    return m_replaced;
+}
@@ -0,0 +1,75 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PAKTAR_H
+#define PAKTAR_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+
+#include "pakdirectory.h"
+
+const size_t TAR_BLOCK_SIZE = 512;
+
+// Writes the entries of a PAK file as a tar stream, in the order their data
+// lies in the PAK file, copying the data straight from it.
+class TarExporter
+{
+public:
+    explicit TarExporter(const char *pakFilename);
+    TarExporter(const TarExporter &other) = delete;
+    TarExporter &operator=(const TarExporter &other) = delete;
+    ~TarExporter();
+
+    void write(int outFd);
+private:
+    std::string pakFile;
+    int pakFd;
+    PakDirectory directory;
+};
+
+// Builds a PAK file from a tar stream in a single pass.  Only one entry's
+// header is held at a time, so memory use does not depend on the size of
+// the stream.  Directories, links and other special files are skipped.
+// As with tar, a later member of the same name replaces an earlier one.
+class TarImporter
+{
+public:
+    explicit TarImporter(const char *pakFilename);
+
+    void setVerbose(bool verbosity);
+    void setSync(bool enable);
+    void setAlignment(bool enable);
+    void read(int inFd);
+    size_t size() const; // Entries added.
+    size_t skipped() const; // Tar entries that were not regular files.
+    size_t replaced() const; // Members replaced by a later one of the same name.
+private:
+    std::string pakFile;
+    bool verbose;
+    bool sync;
+    bool align;
+    size_t m_size;
+    size_t m_skipped;
+    size_t m_replaced;
+};
+
+#endif // PAKTAR_H
@@ -0,0 +1,237 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "extentcopy.h"
+#include "paktypes.h"
+
+static const char *typeNames[FILE_TYPE_COUNT] = {
+    "map", "texture", "graphic", "sound", "demo", "model", "skin", "data", "config", "other"
+};
+
+struct Extension
+{
+    const char *extension;
+    fileTypes type;
+};
+
+static const Extension extensions[] = {
+    {"bsp", fileTypes::Map}, {"map", fileTypes::Map}, {"ent", fileTypes::Map},
+    {"wad", fileTypes::Texture}, {"wal", fileTypes::Texture}, {"mip", fileTypes::Texture},
+    {"lmp", fileTypes::Graphic}, {"pcx", fileTypes::Graphic}, {"tga", fileTypes::Graphic},
+    {"png", fileTypes::Graphic}, {"jpg", fileTypes::Graphic}, {"jpeg", fileTypes::Graphic},
+    {"bmp", fileTypes::Graphic},
+    {"wav", fileTypes::Sound}, {"ogg", fileTypes::Sound}, {"mp3", fileTypes::Sound},
+    {"flac", fileTypes::Sound},
+    {"dem", fileTypes::Demo}, {"dm2", fileTypes::Demo},
+    {"mdl", fileTypes::Model}, {"md2", fileTypes::Model}, {"md3", fileTypes::Model},
+    {"spr", fileTypes::Model}, {"sp2", fileTypes::Model}, {"iqm", fileTypes::Model},
+    {"dat", fileTypes::Data}, {"lit", fileTypes::Data}, {"vis", fileTypes::Data},
+    {"loc", fileTypes::Data}, {"pak", fileTypes::Data}, {"bin", fileTypes::Data},
+    {"cfg", fileTypes::Config}, {"rc", fileTypes::Config}
+};
+
+TypeFilter::TypeFilter() : types(0), minimumSize(0)
+{
+
+}
+
+bool TypeFilter::parse(const std::string &typeNames)
+{
+    size_t start = 0;
+    while (start <= typeNames.size()) {
+        auto end = typeNames.find(',', start);
+        if (end == std::string::npos) {
+            end = typeNames.size();
+        }
+        fileTypes type;
+        if (!PakTypes::parseName(std::string_view(typeNames).substr(start, end - start), type)) {
+            return false;
+        }
+        types |= 1u << int(type);
+        start = end + 1;
+    }
+    return true;
+}
+
+void TypeFilter::setMinimumSize(int64_t size)
+{
+    minimumSize = size;
+}
+
+bool TypeFilter::isActive() const
+{
+    return types != 0 || minimumSize > 0;
+}
+
+bool TypeFilter::matches(fileTypes type, int64_t length) const
+{
+    return (types == 0 || (types & (1u << int(type))) != 0) && length >= minimumSize;
+}
+
+PakTypes::PakTypes()
+{
+    totals.fill(TypeTotal{0, 0});
+}
+
+fileTypes PakTypes::fromName(std::string_view path)
+{
+    auto slash = path.find_last_of('/');
+    auto file = slash == std::string_view::npos ? path : path.substr(slash + 1);
+    auto dot = file.find_last_of('.');
+    if (dot == std::string_view::npos || dot + 1 == file.size() || file.size() - dot > 5) {
+        return fileTypes::Other;
+    }
+    char extension[5] = {};
+    for (size_t x = dot + 1; x < file.size(); ++x) {
+        extension[x - dot - 1] = std::tolower(static_cast<unsigned char>(file[x]));
+    }
+    for (const auto &x : extensions) {
+        if (std::strcmp(x.extension, extension) == 0) {
+            if (x.type == fileTypes::Graphic && slash != std::string_view::npos) {
+                // Images are skins under models and players, and textures
+                // under textures.
+                auto directory = path.substr(0, slash + 1);
+                if (directory.compare(0, 7, "models/") == 0 || directory.compare(0, 8, "players/") == 0) {
+                    return fileTypes::Skin;
+                }
+                if (directory.compare(0, 9, "textures/") == 0) {
+                    return fileTypes::Texture;
+                }
+            }
+            return x.type;
+        }
+    }
+    return fileTypes::Other;
+}
+
+fileTypes PakTypes::fromData(const char *data, size_t length)
+{
+    if (length >= 4) {
+        int32_t version;
+        std::memcpy(&version, data, sizeof(version));
+        if (version == 29 || version == 30 || std::memcmp(data, "IBSP", 4) == 0 || std::memcmp(data, "VBSP", 4) == 0) {
+            return fileTypes::Map; // Quake and Half-Life BSPs start with a version number.
+        }
+        if (std::memcmp(data, "IDPO", 4) == 0 || std::memcmp(data, "IDP2", 4) == 0 ||
+            std::memcmp(data, "IDP3", 4) == 0 || std::memcmp(data, "IDSP", 4) == 0 ||
+            std::memcmp(data, "IDS2", 4) == 0) {
+            return fileTypes::Model;
+        }
+        if (std::memcmp(data, "OggS", 4) == 0 || std::memcmp(data, "ID3", 3) == 0 ||
+            (length >= 12 && std::memcmp(data, "RIFF", 4) == 0 && std::memcmp(data + 8, "WAVE", 4) == 0)) {
+            return fileTypes::Sound;
+        }
+        if (std::memcmp(data, "WAD2", 4) == 0 || std::memcmp(data, "WAD3", 4) == 0) {
+            return fileTypes::Texture;
+        }
+        if (std::memcmp(data, "\x89PNG", 4) == 0 || std::memcmp(data, "\xff\xd8\xff", 3) == 0) {
+            return fileTypes::Graphic;
+        }
+        if (std::memcmp(data, "PACK", 4) == 0) {
+            return fileTypes::Data;
+        }
+    }
+    if (length >= 2 && data[0] == 0x0a && data[1] == 0x05) { // PCX, version 5.
+        return fileTypes::Graphic;
+    }
+    return fileTypes::Other;
+}
+
+const char *PakTypes::name(fileTypes type)
+{
+    return typeNames[int(type)];
+}
+
+bool PakTypes::parseName(std::string_view name, fileTypes &type)
+{
+    for (int x = 0; x < FILE_TYPE_COUNT; ++x) {
+        if (name == typeNames[x]) {
+            type = fileTypes(x);
+            return true;
+        }
+    }
+    return false;
+}
+
+void PakTypes::add(const PakDirectory &directory, size_t record, fileTypes type)
+{
+    types[record] = uint8_t(type);
+    totals[int(type)].files++;
+    totals[int(type)].bytes += directory[record].length;
+}
+
+void PakTypes::classify(const PakDirectory &directory, const char *pakData)
+{
+    types.assign(directory.size(), uint8_t(fileTypes::Other));
+    totals.fill(TypeTotal{0, 0});
+    for (size_t x = 0; x < directory.size(); ++x) {
+        const auto &record = directory[x];
+        auto type = fromName(labelView(record.filename));
+        if (type == fileTypes::Other && record.length > 0 && directory.inBounds(record)) {
+            type = fromData(pakData + record.position, std::min<size_t>(record.length, SNIFF_SIZE));
+        }
+        add(directory, x, type);
+    }
+}
+
+void PakTypes::classify(const PakDirectory &directory, int fd)
+{
+    types.assign(directory.size(), uint8_t(fileTypes::Other));
+    totals.fill(TypeTotal{0, 0});
+    std::vector<size_t> unknown;
+    for (size_t x = 0; x < directory.size(); ++x) {
+        const auto &record = directory[x];
+        auto type = fromName(labelView(record.filename));
+        if (type == fileTypes::Other && record.length > 0 && directory.inBounds(record)) {
+            unknown.push_back(x);
+            continue;
+        }
+        add(directory, x, type);
+    }
+    // Only the first few bytes of the rest are read, front to back.
+    std::sort(unknown.begin(), unknown.end(), [&directory](size_t a, size_t b) {
+        return directory[a].position < directory[b].position;
+    });
+    char header[SNIFF_SIZE];
+    for (auto x : unknown) {
+        auto length = std::min<size_t>(directory[x].length, SNIFF_SIZE);
+        readAll(fd, header, length, directory[x].position);
+        add(directory, x, fromData(header, length));
+    }
+}
+
+fileTypes PakTypes::type(size_t record) const
+{
+    return fileTypes(types[record]);
+}
+
+const TypeTotal &PakTypes::total(fileTypes type) const
+{
+    return totals[int(type)];
+}
+
+size_t PakTypes::size() const
+{
+    return types.size();
+}
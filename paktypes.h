@@ -0,0 +1,85 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PAKTYPES_H
+#define PAKTYPES_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "func.h"
+#include "pakdirectory.h"
+
+// Bytes read from the start of an entry to recognise its type.
+const size_t SNIFF_SIZE = 12;
+
+// Number and total size of the entries of one type.
+struct TypeTotal
+{
+    int64_t files;
+    int64_t bytes;
+};
+
+// Which entries an operation applies to: any of a set of types, at least
+// a given size.  An empty set of types matches every type.
+class TypeFilter
+{
+public:
+    TypeFilter();
+
+    bool parse(const std::string &typeNames); // Comma separated names.  false if one is unknown.
+    void setMinimumSize(int64_t size);
+    bool isActive() const; // Whether anything is filtered out at all.
+    bool matches(fileTypes type, int64_t length) const;
+private:
+    uint32_t types; // One bit per fileTypes value.
+    int64_t minimumSize;
+};
+
+// The type of every entry of a PAK file, one byte each in directory order,
+// with the totals for every type worked out in the same pass.  Entries are
+// classified by extension, and those with an unknown extension by their
+// first few bytes.
+class PakTypes
+{
+public:
+    PakTypes();
+
+    void classify(const PakDirectory &directory, const char *pakData); // From an in memory (mapped) PAK file.
+    void classify(const PakDirectory &directory, int fd); // Reading only the start of entries that need it.
+    fileTypes type(size_t record) const;
+    const TypeTotal &total(fileTypes type) const;
+    size_t size() const;
+
+    static fileTypes fromName(std::string_view path); // By extension and directory.  Other if unknown.
+    static fileTypes fromData(const char *data, size_t length); // By the first bytes.  Other if unknown.
+    static const char *name(fileTypes type);
+    static bool parseName(std::string_view name, fileTypes &type);
+private:
+    std::vector<uint8_t> types;
+    std::array<TypeTotal, FILE_TYPE_COUNT> totals;
+
+    void add(const PakDirectory &directory, size_t record, fileTypes type);
+};
+
+#endif // PAKTYPES_H
@@ -0,0 +1,352 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifdef __linux
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "extentcopy.h"
+#include "pakrepack.h"
+#include "pakwatch.h"
+
+static const uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+
+static volatile sig_atomic_t stopWatching = 0;
+
+static void stopHandler(int)
+{
+    stopWatching = 1;
+}
+
+PakWatcher::PakWatcher(const char *pakFilename, const char *sourceDirectory, const std::string &prefix) :
+    pakFile(pakFilename), sourceDir(sourceDirectory), pakPrefix(prefix), inotifyFd(-1), pakFd(-1),
+    verbose(false), buildCache(nullptr), fileEnd(0), liveBytes(0)
+{
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd == -1) {
+        throw PakException("Could not watch directory", std::strerror(errno));
+    }
+    openPak();
+}
+
+PakWatcher::~PakWatcher()
+{
+    if (inotifyFd != -1) {
+        ::close(inotifyFd);
+    }
+    if (pakFd != -1) {
+        ::close(pakFd);
+    }
+}
+
+void PakWatcher::setVerbose(bool verbosity)
+{
+    verbose = verbosity;
+}
+
+void PakWatcher::setBuildCache(BuildCache *cache)
+{
+    buildCache = cache;
+}
+
+void PakWatcher::openPak()
+{
+    if (pakFd != -1) {
+        ::close(pakFd);
+    }
+    pakFd = ::open(pakFile.c_str(), O_RDWR);
+    if (pakFd == -1) {
+        throw PakException("Could not open file", pakFile.c_str());
+    }
+    PakDirectory directory;
+    directory.load(pakFd);
+    records.assign(directory.begin(), directory.end());
+    fileEnd = directory.fileSize();
+    liveBytes = 0;
+    for (const auto &x : records) {
+        liveBytes += x.length;
+    }
+}
+
+void PakWatcher::addWatches(const std::string &relative, std::set<std::string> &found)
+{
+    std::string path = sourceDir + "/" + relative;
+    int wd = inotify_add_watch(inotifyFd, path.c_str(), WATCH_EVENTS | IN_ONLYDIR);
+    if (wd == -1) {
+        return; // Gone already, or not a directory.
+    }
+    watches[wd] = relative;
+
+    DIR *directory = opendir(path.c_str());
+    if (directory == nullptr) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != nullptr) {
+        if (std::strcmp(".", entry->d_name) == 0 || std::strcmp("..", entry->d_name) == 0) {
+            continue;
+        }
+        std::string child = relative.empty() ? entry->d_name : relative + "/" + entry->d_name;
+        struct stat statbuf;
+        if (stat((sourceDir + "/" + child).c_str(), &statbuf) != 0) {
+            continue;
+        }
+        if (S_ISDIR(statbuf.st_mode)) {
+            addWatches(child, found);
+        } else if (S_ISREG(statbuf.st_mode)) {
+            found.insert(child);
+        }
+    }
+    closedir(directory);
+}
+
+void PakWatcher::readEvents(std::set<std::string> &changed, std::set<std::string> &removedDirectories)
+{
+    alignas(struct inotify_event) char buffer[COPY_BUFFER_SIZE];
+
+    for (;;) {
+        auto got = ::read(inotifyFd, buffer, sizeof(buffer));
+        if (got <= 0) {
+            return; // EAGAIN once drained.
+        }
+        for (char *pos = buffer; pos < buffer + got;) {
+            auto *event = reinterpret_cast<struct inotify_event *>(pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost, so look at everything again.
+                std::set<std::string> everything;
+                watches.clear();
+                addWatches("", everything);
+                changed.insert(everything.begin(), everything.end());
+                removedDirectories.insert("");
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watches.erase(event->wd);
+                continue;
+            }
+            auto dir = watches.find(event->wd);
+            if (dir == watches.end() || event->len == 0) {
+                continue;
+            }
+            std::string relative = dir->second.empty() ? event->name : dir->second + "/" + event->name;
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    addWatches(relative, changed);
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    removedDirectories.insert(relative + "/");
+                }
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM)) {
+                changed.insert(relative);
+            }
+        }
+    }
+}
+
+bool PakWatcher::removeRecord(const std::string &name)
+{
+    auto found = std::find_if(records.begin(), records.end(), [&name](const PakRecord &x) {
+        return x.name() == name;
+    });
+    if (found != records.end()) {
+        liveBytes -= found->length;
+        records.erase(found);
+        return true;
+    }
+    return false;
+}
+
+void PakWatcher::applyBatch(const std::set<std::string> &changed, const std::set<std::string> &removedDirectories)
+{
+    auto started = std::chrono::steady_clock::now();
+    size_t updated = 0;
+    size_t removed = 0;
+
+    // A directory that disappeared takes everything under it, unless the
+    // files turn up again in changed.  "" (everything) after an overflow.
+    for (const auto &dir : removedDirectories) {
+        auto prefix = pakPrefix + dir;
+        auto end = std::remove_if(records.begin(), records.end(), [&](const PakRecord &x) {
+            return x.name().compare(0, prefix.size(), prefix) == 0 &&
+                   (!dir.empty() || changed.find(x.name().substr(pakPrefix.size())) == changed.end());
+        });
+        for (auto x = end; x != records.end(); ++x) {
+            liveBytes -= x->length;
+            if (buildCache != nullptr) {
+                buildCache->remove(x->name());
+            }
+            ++removed;
+        }
+        records.erase(end, records.end());
+    }
+
+    // New data goes after the current directory, which is left alone until
+    // the header points at the new one, so readers never see a torn file.
+    if (lseek(pakFd, fileEnd, SEEK_SET) == -1) {
+        throw PakException("Error writing file", pakFile.c_str());
+    }
+    int64_t position = fileEnd;
+    for (const auto &relative : changed) {
+        auto name = pakPrefix + relative;
+        auto source = sourceDir + "/" + relative;
+        bool existed = removeRecord(name);
+
+        struct stat statbuf;
+        if (stat(source.c_str(), &statbuf) != 0 || !S_ISREG(statbuf.st_mode)) {
+            if (buildCache != nullptr) {
+                buildCache->remove(name);
+            }
+            if (existed) {
+                ++removed;
+            }
+            continue; // Deleted
+        }
+        if (name.size() > (PAK_DATA_LABEL_SIZE - 1)) {
+            std::cout << "Skipping " << name << ", path name too long.\n";
+            continue;
+        }
+        int fd = ::open(source.c_str(), O_RDONLY);
+        if (fd == -1) {
+            continue; // Removed since the event.
+        }
+        if (position + statbuf.st_size > std::numeric_limits<int32_t>::max()) {
+            ::close(fd);
+            throw (PakException("File too large.", "PAK files cannot exceed 2GB in size." ));
+        }
+        PakRecord record;
+        stringToArray(name, record.filename);
+        record.position = position;
+        record.length = statbuf.st_size;
+        try {
+            copyExtent(fd, 0, pakFd, statbuf.st_size);
+        } catch (PakException &) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        position += statbuf.st_size;
+        liveBytes += statbuf.st_size;
+        records.push_back(record);
+        if (buildCache != nullptr) {
+            buildCache->update(name, statbuf);
+        }
+        ++updated;
+    }
+
+    std::vector<char> table(records.size() * DIRECTORY_ENTRY_SIZE);
+    char *pos = table.data();
+    for (const auto &record : records) {
+        std::copy(record.filename.begin(), record.filename.end(), pos);
+        std::memcpy(pos + PAK_DATA_LABEL_SIZE, &record.position, sizeof(int32_t));
+        std::memcpy(pos + PAK_DATA_LABEL_SIZE + sizeof(int32_t), &record.length, sizeof(int32_t));
+        pos += DIRECTORY_ENTRY_SIZE;
+    }
+    const int32_t directoryOffset = position;
+    const int32_t directoryLength = table.size();
+    safeAdd(directoryOffset, directoryLength);
+    writeAll(pakFd, table.data(), table.size());
+    fdatasync(pakFd); // The directory must be on disk before the header points to it.
+
+    char header[PAK_HEADER_SIZE];
+    std::memcpy(header, "PACK", 4);
+    std::memcpy(header + 4, &directoryOffset, sizeof(int32_t));
+    std::memcpy(header + 8, &directoryLength, sizeof(int32_t));
+    if (::pwrite(pakFd, header, PAK_HEADER_SIZE, 0) != PAK_HEADER_SIZE) {
+        throw PakException("Error writing file", pakFile.c_str());
+    }
+    fileEnd = position + directoryLength;
+
+    if (verbose) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        std::cout << "Updated " << updated << " files, removed " << removed << " in " << elapsed.count() << " ms.\n";
+    }
+    compactIfNeeded();
+}
+
+// Once more than half of the file is dead space, repack it.
+void PakWatcher::compactIfNeeded()
+{
+    int64_t used = PAK_HEADER_SIZE + liveBytes + static_cast<int64_t>(records.size()) * DIRECTORY_ENTRY_SIZE;
+    if (fileEnd - used <= used) {
+        return;
+    }
+    PakRepack repack(pakFile.c_str());
+    repack.write(pakFile.c_str());
+    openPak();
+    if (verbose) {
+        std::cout << "Compacted " << pakFile << " to " << fileEnd << " bytes.\n";
+    }
+}
+
+void PakWatcher::run()
+{
+    std::set<std::string> changed;
+    std::set<std::string> removedDirectories;
+    std::set<std::string> initial;
+
+    addWatches("", initial);
+    stopWatching = 0;
+    signal(SIGINT, stopHandler);
+    signal(SIGTERM, stopHandler);
+
+    if (verbose) {
+        std::cout << "Watching " << sourceDir << " for changes.  Press Ctrl-C to stop.\n";
+    }
+    while (!stopWatching) {
+        struct pollfd poller = {inotifyFd, POLLIN, 0};
+        // Wait indefinitely for the first change, then only for the debounce period.
+        int timeout = changed.empty() && removedDirectories.empty() ? -1 : WATCH_DEBOUNCE_MS;
+        int ready = poll(&poller, 1, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw PakException("Could not watch directory", std::strerror(errno));
+        }
+        if (ready > 0) {
+            readEvents(changed, removedDirectories);
+            continue;
+        }
+        applyBatch(changed, removedDirectories);
+        changed.clear();
+        removedDirectories.clear();
+    }
+    if (!changed.empty() || !removedDirectories.empty()) {
+        applyBatch(changed, removedDirectories);
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+}
+
+#endif // __linux
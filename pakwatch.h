@@ -0,0 +1,79 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PAKWATCH_H
+#define PAKWATCH_H
+
+#ifdef __linux
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "buildcache.h"
+#include "pakdirectory.h"
+
+// Time to wait for more changes before updating the PAK file, so that a
+// burst of saves is applied as one update.
+const int WATCH_DEBOUNCE_MS = 100;
+
+// Keeps a PAK file in step with a directory, using inotify.  Files are
+// mapped to PAK paths the same way importDirectory() maps them.  Changed
+// files are appended to the end of the PAK file and a new directory is
+// written after them, so each update only writes what changed.  The
+// space left behind is reclaimed by repacking once it grows too large.
+class PakWatcher
+{
+public:
+    PakWatcher(const char *pakFilename, const char *sourceDirectory, const std::string &prefix);
+    PakWatcher(const PakWatcher &other) = delete;
+    PakWatcher &operator=(const PakWatcher &other) = delete;
+    ~PakWatcher();
+
+    void setVerbose(bool verbosity);
+    void setBuildCache(BuildCache *cache); // Kept up to date with what is written.
+    void run(); // Returns on SIGINT or SIGTERM.
+private:
+    std::string pakFile;
+    std::string sourceDir;
+    std::string pakPrefix;
+    int inotifyFd;
+    int pakFd;
+    bool verbose;
+    BuildCache *buildCache;
+    std::unordered_map<int, std::string> watches; // Watch descriptor to directory, relative to sourceDir.
+    std::vector<PakRecord> records;
+    int64_t fileEnd;
+    int64_t liveBytes;
+
+    void openPak();
+    void addWatches(const std::string &relative, std::set<std::string> &found);
+    void readEvents(std::set<std::string> &changed, std::set<std::string> &removedDirectories);
+    void applyBatch(const std::set<std::string> &changed, const std::set<std::string> &removedDirectories);
+    bool removeRecord(const std::string &name);
+    void compactIfNeeded();
+};
+
+#endif // __linux
+
+#endif // PAKWATCH_H
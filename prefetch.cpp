@@ -0,0 +1,88 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <fcntl.h>
+
+#include "prefetch.h"
+
+std::vector<ByteRange> coalesceRanges(std::vector<ByteRange> ranges, int64_t gap)
+{
+    ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [](const ByteRange &x) {
+        return x.length <= 0;
+    }), ranges.end());
+    std::sort(ranges.begin(), ranges.end(), [](const ByteRange &a, const ByteRange &b) {
+        return a.offset < b.offset;
+    });
+
+    std::vector<ByteRange> merged;
+    for (const auto &x : ranges) {
+        if (!merged.empty() && x.offset <= merged.back().offset + merged.back().length + gap) {
+            auto end = std::max(merged.back().offset + merged.back().length, x.offset + x.length);
+            merged.back().length = end - merged.back().offset;
+        } else {
+            merged.push_back(x);
+        }
+    }
+    return merged;
+}
+
+Prefetcher::Prefetcher() : stopping(false)
+{
+
+}
+
+Prefetcher::~Prefetcher()
+{
+    wait();
+}
+
+void Prefetcher::start(int fd, std::vector<ByteRange> ranges)
+{
+    wait();
+    ranges = coalesceRanges(std::move(ranges));
+    worker = std::thread([this, fd, ranges]() {
+        for (const auto &x : ranges) {
+            if (stopping) {
+                break;
+            }
+#ifdef __linux
+            posix_fadvise(fd, x.offset, x.length, POSIX_FADV_WILLNEED);
+#elif __APPLE__
+            radvisory advice;
+            advice.ra_offset = x.offset;
+            advice.ra_count = x.length;
+            fcntl(fd, F_RDADVISE, &advice);
+#else
+            (void)fd;
+            (void)x;
+#endif
+        }
+    });
+}
+
+void Prefetcher::wait()
+{
+    if (worker.joinable()) {
+        stopping = true;
+        worker.join();
+    }
+    stopping = false;
+}
@@ -0,0 +1,61 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Ranges closer together than this are read ahead as one.
+const int64_t PREFETCH_GAP = 1 << 16;
+
+struct ByteRange
+{
+    int64_t offset;
+    int64_t length;
+};
+
+// Sorts ranges by offset and merges those that overlap or lie within gap
+// bytes of each other.
+std::vector<ByteRange> coalesceRanges(std::vector<ByteRange> ranges, int64_t gap = PREFETCH_GAP);
+
+// Asks the kernel to start reading ranges of a file into the page cache on
+// a background thread, so later reads of them do not wait on the disk.
+// Only a hint: nothing is read into our own memory, and on platforms
+// without read ahead hints it does nothing.
+class Prefetcher
+{
+public:
+    Prefetcher();
+    Prefetcher(const Prefetcher &other) = delete;
+    Prefetcher &operator=(const Prefetcher &other) = delete;
+    ~Prefetcher();
+
+    void start(int fd, std::vector<ByteRange> ranges); // fd must stay open until wait().
+    void wait(); // Stop hinting any ranges not yet reached and wait for the thread.
+private:
+    std::thread worker;
+    std::atomic<bool> stopping;
+};
+
+#endif // PREFETCH_H
@@ -0,0 +1,109 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <iostream>
+#include "pakexception.h"
+#include "progress.h"
+
+void ProgressObserver::message(const std::string &line)
+{
+    std::cout << line;
+}
+
+ProgressTracker::ProgressTracker() :
+    observer(nullptr), token(nullptr), info{"", 0, 0, 0, 0, 0, -1, false}, lastBytes(0)
+{
+
+}
+
+void ProgressTracker::setObserver(ProgressObserver *newObserver)
+{
+    observer = newObserver;
+}
+
+void ProgressTracker::setCancellation(const CancellationToken *newToken)
+{
+    token = newToken;
+}
+
+void ProgressTracker::start(const char *operation, int64_t entries, int64_t bytes)
+{
+    info = ProgressInfo{operation, 0, entries, 0, bytes, 0, -1, false};
+    lastReport = std::chrono::steady_clock::now();
+    lastBytes = 0;
+}
+
+void ProgressTracker::addTotal(int64_t bytes)
+{
+    info.entriesTotal++;
+    info.bytesTotal += bytes;
+}
+
+void ProgressTracker::message(const std::string &line)
+{
+    if (observer != nullptr) {
+        observer->message(line);
+    } else {
+        std::cout << line;
+    }
+}
+
+void ProgressTracker::step(int64_t bytes)
+{
+    if (token != nullptr && token->cancelled()) {
+        finish(); // So the observer can tidy up.
+        throw PakException("Cancelled", info.operation);
+    }
+    info.entriesDone++;
+    info.bytesDone += bytes;
+    if (observer == nullptr) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastReport >= std::chrono::milliseconds(PROGRESS_INTERVAL_MS)) {
+        report(now);
+    }
+}
+
+void ProgressTracker::report(std::chrono::steady_clock::time_point now)
+{
+    std::chrono::duration<double> elapsed = now - lastReport;
+    if (elapsed.count() > 0) {
+        // Smoothed, so the rate and time left do not jump about between reports.
+        double rate = (info.bytesDone - lastBytes) / elapsed.count();
+        info.bytesPerSecond = info.bytesPerSecond == 0 ? rate : 0.7 * info.bytesPerSecond + 0.3 * rate;
+    }
+    info.secondsLeft = -1;
+    if (info.bytesTotal > 0 && info.bytesPerSecond > 0) {
+        info.secondsLeft = (info.bytesTotal - info.bytesDone) / info.bytesPerSecond;
+    }
+    lastReport = now;
+    lastBytes = info.bytesDone;
+    observer->progress(info);
+}
+
+void ProgressTracker::finish()
+{
+    if (observer != nullptr) {
+        info.finished = true;
+        report(std::chrono::steady_clock::now());
+        info.finished = false;
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Minimum time between progress reports.
+const int PROGRESS_INTERVAL_MS = 100;
+
+struct ProgressInfo
+{
+    const char *operation;
+    int64_t entriesDone;
+    int64_t entriesTotal; // 0 when not known in advance, as when importing.
+    int64_t bytesDone;
+    int64_t bytesTotal;
+    double bytesPerSecond;
+    double secondsLeft; // Negative when not known.
+    bool finished; // Set on the last report of an operation.
+};
+
+// Receives progress reports from long running Pak operations.
+class ProgressObserver
+{
+public:
+    virtual ~ProgressObserver() {}
+    virtual void progress(const ProgressInfo &info) = 0;
+    // Prints a line of verbose output.  An observer drawing on the terminal
+    // clears its report first, so the two do not run together.
+    virtual void message(const std::string &line);
+};
+
+// Set to ask a running operation to stop.  It is checked between entries,
+// and the operation then throws a PakException, leaving any PAK file it was
+// writing untouched.
+class CancellationToken
+{
+public:
+    CancellationToken() : flag(false) {}
+    void cancel() { flag = true; } // Safe to call from a signal handler.
+    void reset() { flag = false; }
+    bool cancelled() const { return flag; }
+private:
+    std::atomic<bool> flag;
+};
+
+// Counts entries and bytes for one operation at a time, and passes rate
+// limited reports to an observer.  Costs a single test per entry when
+// there is neither an observer nor a cancellation token.
+class ProgressTracker
+{
+public:
+    ProgressTracker();
+
+    void setObserver(ProgressObserver *observer);
+    void setCancellation(const CancellationToken *token);
+    void start(const char *operation, int64_t entries = 0, int64_t bytes = 0);
+    void addTotal(int64_t bytes); // Count one more entry of bytes in the total.
+    void message(const std::string &line); // Verbose output, through the observer if there is one.
+    void advance(int64_t bytes) // One entry of bytes is done.
+    {
+        if (observer != nullptr || token != nullptr) {
+            step(bytes);
+        }
+    }
+    void finish();
+private:
+    ProgressObserver *observer;
+    const CancellationToken *token;
+    ProgressInfo info;
+    std::chrono::steady_clock::time_point lastReport;
+    int64_t lastBytes;
+
+    void step(int64_t bytes);
+    void report(std::chrono::steady_clock::time_point now);
+};
+
+#endif // PROGRESS_H
@@ -20,11 +20,25 @@
 
 #include "treeitem.h"
 
-std::unique_ptr< TreeItem > createTreeItem(const std::string label, TreeItem *parent)
+void TreeItemDeleter::operator()(TreeItem *item) const
 {
+  std::pmr::polymorphic_allocator<TreeItem> allocator(resource);
+  item->~TreeItem();
+  allocator.deallocate(item, 1);
+}
 
-  std::unique_ptr<TreeItem> x(new TreeItem(label, parent));
-  return x;
+TreeItemPtr createTreeItem(std::string_view label, TreeItem *parent)
+{
+  auto *resource = parent->resource();
+  std::pmr::polymorphic_allocator<TreeItem> allocator(resource);
+  TreeItem *item = allocator.allocate(1);
+  try {
+      allocator.construct(item, label, parent, resource);
+    } catch (...) {
+      allocator.deallocate(item, 1);
+      throw;
+    }
+  return TreeItemPtr(item, TreeItemDeleter{resource});
 }
 
 
@@ -34,7 +48,7 @@ void TreeItem::deleteChildTree(const int pos)
   childItems.erase(childItems.begin()+pos);
 }
 
-void TreeItem::deleteChildTree(std::vector< std::unique_ptr< TreeItem > >::iterator it)
+void TreeItem::deleteChildTree(std::pmr::vector<TreeItemPtr>::iterator it)
 {
   childItems.erase(it);
 }
@@ -69,10 +83,12 @@ void TreeItem::traverseForEachItem(void(Pak::*func)(DirectoryEntry &item), Pak *
 }
 
 
-TreeItem::TreeItem(const std::string o_label, TreeItem *o_parent)
+TreeItem::TreeItem(std::string_view o_label, TreeItem *o_parent, std::pmr::memory_resource *resource) :
+  childItems(resource ? resource : std::pmr::get_default_resource()),
+  items(childItems.get_allocator()),
+  parent(o_parent),
+  directoryLabel(o_label, childItems.get_allocator())
 {
-  parent = o_parent;
-  directoryLabel = o_label;
 
 }
 
@@ -81,7 +97,7 @@ TreeItem::~TreeItem()
   clear();
 }
 
-void TreeItem::appendChild(std::unique_ptr<TreeItem> child)
+void TreeItem::appendChild(TreeItemPtr child)
 {
   childItems.push_back(std::move(child));
 
@@ -149,10 +165,10 @@ TreeItem *TreeItem::parentItem()
   return parent;
 }
 
-TreeItem *TreeItem::findChild(std::string searchTerm, bool create)
+TreeItem *TreeItem::findChild(std::string_view searchTerm, bool create)
 {
   if (childItems.empty() && create) {
-      std::unique_ptr<TreeItem> x = createTreeItem(searchTerm, this);
+      TreeItemPtr x = createTreeItem(searchTerm, this);
       appendChild(std::move(x));
       return childItems.back().get();
     }
@@ -165,14 +181,14 @@ TreeItem *TreeItem::findChild(std::string searchTerm, bool create)
   if (create == false) {
       return nullptr;
     } else {
-      std::unique_ptr<TreeItem> x = createTreeItem(searchTerm, this);
+      TreeItemPtr x = createTreeItem(searchTerm, this);
       appendChild(std::move(x));
       return childItems.back().get();
     }
   return nullptr;
 }
 
-std::string TreeItem::label() const
+const std::pmr::string &TreeItem::label() const
 {
   return directoryLabel;
 }
@@ -195,11 +211,13 @@ std::string TreeItem::pathLabel() const
   return fullpath;
 }
 
-DirectoryEntry* TreeItem::findEntry ( const std::string searchTerm )
+DirectoryEntry* TreeItem::findEntry ( std::string_view searchTerm )
 {
   for ( auto &x : items )
     {
-      if ( std::equal ( searchTerm.begin(), searchTerm.end(), x.filename.begin() ) )
+      if ( searchTerm.size() <= x.filename.size() &&
+           std::equal ( searchTerm.begin(), searchTerm.end(), x.filename.begin() ) &&
+           ( searchTerm.size() == x.filename.size() || x.filename[searchTerm.size()] == '\0' ) )
         {
 	  return &x;
         }
@@ -207,7 +225,7 @@ DirectoryEntry* TreeItem::findEntry ( const std::string searchTerm )
     return nullptr;
 }
 
-int TreeItem::findEntryRow ( const std::string searchTerm )
+int TreeItem::findEntryRow ( std::string_view searchTerm )
 {
   if (searchTerm.length() == 0) return -1;
   std::string absFile;
@@ -262,6 +280,15 @@ void TreeItem::clear()
 {
   items.clear();
   childItems.clear();
+  // Swapping with empty lists frees their storage too, so an arena the
+  // tree was allocated from can be released afterwards.
+  decltype(items)(items.get_allocator()).swap(items);
+  decltype(childItems)(childItems.get_allocator()).swap(childItems);
+}
+
+std::pmr::memory_resource *TreeItem::resource() const
+{
+  return childItems.get_allocator().resource();
 }
 
 
@@ -282,20 +309,23 @@ TreeItemItr &TreeItem::operator*()
 }
 
 
-TreeItem *TreeItem::findTreeItem(const std::string path,
+TreeItem *TreeItem::findTreeItem(std::string_view path,
 			      const bool createIfNotfound)
 {
     if (path.empty()) {
         return nullptr;
     }
     TreeItem *tItem = this;
-    stringList t = tokenize(path);
+    PathComponents components(path);
+    std::string_view x;
 
-    for (auto &x : t) {
+    while (components.next(x)) {
         tItem = tItem->findChild(x, createIfNotfound);
         if (tItem == nullptr) {
           std::string message;
-          message += "Directory " + x + " could not be found.";
+          message += "Directory ";
+          message += x;
+          message += " could not be found.";
           throw PakException("Invalid directory",message.c_str());
         }
     }
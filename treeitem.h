@@ -22,8 +22,10 @@
 #define TREEITEM_H
 #include <vector>
 #include <memory>
+#include <memory_resource>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <cassert>
 #include "func.h"
 
@@ -38,47 +40,60 @@ class Pak;
 
 class TreeItem;
 
-using TreeItemItr = std::vector<DirectoryEntry>::iterator;
-using const_TreeItemItr = std::vector<DirectoryEntry>::const_iterator;
+using TreeItemItr = std::pmr::vector<DirectoryEntry>::iterator;
+using const_TreeItemItr = std::pmr::vector<DirectoryEntry>::const_iterator;
 
-std::unique_ptr<TreeItem> createTreeItem( const std::string label, TreeItem* parent);
+// Destroys a TreeItem and returns its memory to the resource it came from.
+struct TreeItemDeleter
+{
+    std::pmr::memory_resource *resource;
+    void operator()(TreeItem *item) const;
+};
+using TreeItemPtr = std::unique_ptr<TreeItem, TreeItemDeleter>;
+
+// The child is allocated from the parent's memory resource.
+TreeItemPtr createTreeItem( std::string_view label, TreeItem* parent);
 
 class TreeItem
 {
 public:
 
-    explicit TreeItem ( const std::string o_label = "root", TreeItem *o_parent = nullptr );
+    // Labels, entries and children all come from resource, the default
+    // resource if nullptr.
+    explicit TreeItem ( std::string_view o_label = "root", TreeItem *o_parent = nullptr,
+                        std::pmr::memory_resource *resource = nullptr );
     ~TreeItem();
     void traverseForEachChild (void(Pak::*func)(TreeItem *), Pak *obj);
     void traverseForEachItem (void(Pak::*func)(DirectoryEntry &entry), Pak *obj);
-    void appendChild ( std::unique_ptr<TreeItem> child );
+    void appendChild ( TreeItemPtr child );
     void deleteChildTree( const int pos);
-    void deleteChildTree( std::vector<std::unique_ptr<TreeItem>>::iterator it);
+    void deleteChildTree( std::pmr::vector<TreeItemPtr>::iterator it);
     void appendItem ( DirectoryEntry &entry );
     TreeItem *child ( int row ); // Retreive child.
-    std::string label() const; // Returns the name of the directory
+    const std::pmr::string &label() const; // Returns the name of the directory
     std::string pathLabel() const; // Returns name of the directory and full path.
     virtual int row() const;
     TreeItem *paren();
     int size() const; // Returns number of DirectoryEntry items.
-    void clear();
+    void clear(); // Also gives back the memory of the lists of entries and children.
+    std::pmr::memory_resource *resource() const;
     TreeItemItr begin();
     TreeItemItr end();
     TreeItemItr& operator*();
     int childCount() const;
     int columnCount() const;
-    TreeItem *findChild ( std::string searchTerm, bool create = false ); // Returns the child that matches the directory.  Creates one if it does not exist if flag set                              
+    TreeItem *findChild ( std::string_view searchTerm, bool create = false ); // Returns the child that matches the directory.  Creates one if it does not exist if flag set                              
     DirectoryEntry &data ( unsigned int row );
-    DirectoryEntry* findEntry ( const std::string searchTerm );
-    int findEntryRow ( const std::string searchTerm );
+    DirectoryEntry* findEntry ( std::string_view searchTerm );
+    int findEntryRow ( std::string_view searchTerm );
     TreeItem *parentItem();
     void deleteItem(const unsigned int row);
-    TreeItem *findTreeItem(const std::string path, const bool createIfNotfound = false);
+    TreeItem *findTreeItem(std::string_view path, const bool createIfNotfound = false);
 private:
-    std::vector<std::unique_ptr<TreeItem>> childItems;
-    std::vector<DirectoryEntry> items;
+    std::pmr::vector<TreeItemPtr> childItems;
+    std::pmr::vector<DirectoryEntry> items;
     TreeItem *parent;
-    std::string directoryLabel;
+    std::pmr::string directoryLabel;
     int childIndexOf(const TreeItem *ptr);
 
     TreeItemItr itr;
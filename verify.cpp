@@ -0,0 +1,319 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include "crc32c.h"
+#include "verify.h"
+
+// Large entries are split into pieces of this size so that a pak holding a
+// few huge files still keeps every thread busy.
+static const size_t CHECKSUM_CHUNK_SIZE = 4 << 20;
+
+// Parses the whole of text as a number, or returns false.
+template <typename T>
+static bool parseField(const std::string &text, T &value, int base = 10)
+{
+    const char *end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value, base);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+static std::string hexString(uint32_t value)
+{
+    char buffer[9];
+    std::snprintf(buffer, sizeof(buffer), "%08x", value);
+    return buffer;
+}
+
+PakVerifier::PakVerifier(const char *filename) :
+    pakFile(filename), threadCount(0), m_bytesChecked(0)
+{
+    pakData.open(filename);
+}
+
+void PakVerifier::setThreads(unsigned int threads)
+{
+    threadCount = threads;
+}
+
+void PakVerifier::addProblem(const PakRecord &record, const std::string &problem)
+{
+    m_problems.push_back(record.name() + " : " + problem);
+}
+
+int PakVerifier::verify()
+{
+    m_problems.clear();
+    try {
+        m_directory.load(pakData.data(), pakData.size());
+    } catch (PakException &e) {
+        m_problems.push_back(pakFile + " : " + e.where());
+        return m_problems.size();
+    }
+    checkDirectory();
+    computeChecksums();
+    return m_problems.size();
+}
+
+void PakVerifier::checkDirectory()
+{
+    const int64_t directoryEnd = static_cast<int64_t>(m_directory.offset()) + m_directory.length();
+    std::set<std::string> names;
+
+    valid.assign(m_directory.size(), false);
+    for (size_t x = 0; x < m_directory.size(); ++x) {
+        const auto &record = m_directory[x];
+        if (record.filename[0] == '\0') {
+            addProblem(record, "empty file name");
+        } else if (std::find(record.filename.begin(), record.filename.end(), '\0') == record.filename.end()) {
+            addProblem(record, "file name is not terminated");
+        }
+        if (names.insert(record.name()).second == false) {
+            addProblem(record, "duplicate entry");
+        }
+        if (!m_directory.inBounds(record)) {
+            addProblem(record, "data lies outside of the file (offset " + std::to_string(record.position) +
+                       ", length " + std::to_string(record.length) + ")");
+            continue;
+        }
+        if (record.length > 0 && record.position < directoryEnd && record.end() > m_directory.offset()) {
+            addProblem(record, "data overlaps the directory");
+        }
+        valid[x] = true;
+    }
+
+    // Walk the entries in offset order and look for any that start before
+    // the furthest end seen so far.  Records which share exactly the same
+    // data are allowed, as some tools write them deliberately.
+    std::vector<size_t> order;
+    for (size_t x = 0; x < m_directory.size(); ++x) {
+        if (valid[x] && m_directory[x].length > 0) {
+            order.push_back(x);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        const auto &ra = m_directory[a];
+        const auto &rb = m_directory[b];
+        return ra.position != rb.position ? ra.position < rb.position : ra.length < rb.length;
+    });
+
+    size_t furthest = 0;
+    for (size_t x = 0; x < order.size(); ++x) {
+        const auto &record = m_directory[order[x]];
+        if (x > 0) {
+            const auto &previous = m_directory[furthest];
+            bool shared = previous.position == record.position && previous.length == record.length;
+            if (record.position < previous.end() && !shared) {
+                addProblem(record, "data overlaps " + previous.name());
+            }
+        }
+        if (x == 0 || record.end() > m_directory[furthest].end()) {
+            furthest = order[x];
+        }
+    }
+}
+
+void PakVerifier::computeChecksums()
+{
+    struct Chunk {
+        size_t record;
+        int64_t offset;
+        size_t length;
+        uint32_t crc;
+    };
+    std::vector<Chunk> chunks;
+
+    m_bytesChecked = 0;
+    for (size_t x = 0; x < m_directory.size(); ++x) {
+        if (!valid[x]) {
+            continue;
+        }
+        const auto &record = m_directory[x];
+        int64_t offset = record.position;
+        size_t remaining = record.length;
+        do {
+            auto length = std::min(remaining, CHECKSUM_CHUNK_SIZE);
+            chunks.push_back(Chunk{x, offset, length, 0});
+            offset += length;
+            remaining -= length;
+        } while (remaining > 0);
+        m_bytesChecked += record.length;
+    }
+
+    pakData.adviseSequential();
+    unsigned int threads = threadCount;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min<size_t>(threads, std::max<size_t>(1, chunks.size()));
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (auto x = next++; x < chunks.size(); x = next++) {
+            auto &chunk = chunks[x];
+            chunk.crc = crc32c(0, pakData.data() + chunk.offset, chunk.length);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int x = 1; x < threads; ++x) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+
+    // Chunks are in record order, so each record's pieces can be folded
+    // together in a single pass.
+    m_checksums.assign(m_directory.size(), 0);
+    for (size_t x = 0; x < chunks.size(); ++x) {
+        const auto &chunk = chunks[x];
+        if (x == 0 || chunks[x - 1].record != chunk.record) {
+            m_checksums[chunk.record] = chunk.crc;
+        } else {
+            m_checksums[chunk.record] = crc32cCombine(m_checksums[chunk.record], chunk.crc, chunk.length);
+        }
+    }
+}
+
+void PakVerifier::writeManifest(const char *manifestFile)
+{
+    std::ofstream fout;
+    fout.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    try {
+        fout.open(manifestFile, std::ios_base::out | std::ios_base::trunc);
+        fout << "# crc32c\tlength\tname\n";
+        for (size_t x = 0; x < m_directory.size(); ++x) {
+            if (!valid[x]) {
+                continue;
+            }
+            const auto &record = m_directory[x];
+            fout << hexString(m_checksums[x]) << '\t' << record.length << '\t' << record.name() << '\n';
+        }
+        fout.close();
+    } catch (std::ofstream::failure &e) {
+        throw PakException("Error writing file", manifestFile);
+    }
+}
+
+int PakVerifier::compareManifest(const char *manifestFile)
+{
+    std::ifstream fin(manifestFile);
+    if (!fin.is_open()) {
+        throw PakException("Could not open file", manifestFile);
+    }
+
+    // A name can be in a PAK file more than once, and writeManifest() lists
+    // every copy, so the copies of a name are matched up in order.
+    struct Copies
+    {
+        std::vector<std::pair<uint32_t, int32_t>> lines; // Checksum and length, in manifest order.
+        size_t next = 0; // The first not yet matched.
+    };
+    std::map<std::string, Copies> manifest;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(fin, line)) {
+        ++lineNumber;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string crc, length, name;
+        uint32_t crcValue;
+        int32_t lengthValue;
+        if (!std::getline(fields, crc, '\t') || !std::getline(fields, length, '\t') || !std::getline(fields, name) ||
+            !parseField(crc, crcValue, 16) || !parseField(length, lengthValue) || lengthValue < 0) {
+            std::string where = std::string(manifestFile) + ":" + std::to_string(lineNumber);
+            throw PakException("Invalid manifest", where.c_str());
+        }
+        manifest[name].lines.emplace_back(crcValue, lengthValue);
+    }
+
+    int mismatches = 0;
+    std::vector<size_t> skipped; // Invalid records, which writeManifest() leaves out.
+    for (size_t x = 0; x < m_directory.size(); ++x) {
+        const auto &record = m_directory[x];
+        if (!valid[x]) {
+            skipped.push_back(x);
+            continue; // Already reported by checkDirectory()
+        }
+        auto found = manifest.find(record.name());
+        if (found == manifest.end() || found->second.next == found->second.lines.size()) {
+            addProblem(record, "not in manifest");
+            ++mismatches;
+            continue;
+        }
+        const auto &expected = found->second.lines[found->second.next++];
+        if (expected.second != record.length) {
+            addProblem(record, "length " + std::to_string(record.length) + " does not match manifest length " +
+                       std::to_string(expected.second));
+            ++mismatches;
+        } else if (expected.first != m_checksums[x]) {
+            addProblem(record, "checksum " + hexString(m_checksums[x]) + " does not match manifest checksum " +
+                       hexString(expected.first));
+            ++mismatches;
+        }
+    }
+    // An invalid record accounts for one copy left over, so it is not
+    // reported a second time as missing.
+    for (auto x : skipped) {
+        auto found = manifest.find(m_directory[x].name());
+        if (found != manifest.end() && found->second.next < found->second.lines.size()) {
+            ++found->second.next;
+        }
+    }
+    for (const auto &missing : manifest) {
+        for (auto x = missing.second.next; x < missing.second.lines.size(); ++x) {
+            m_problems.push_back(missing.first + " : missing from " + pakFile);
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+const stringList &PakVerifier::problems() const
+{
+    return m_problems;
+}
+
+const PakDirectory &PakVerifier::directory() const
+{
+    return m_directory;
+}
+
+const std::vector<uint32_t> &PakVerifier::checksums() const
+{
+    return m_checksums;
+}
+
+int64_t PakVerifier::bytesChecked() const
+{
+    return m_bytesChecked;
+}
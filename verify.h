@@ -0,0 +1,63 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "func.h"
+#include "mappedfile.h"
+#include "pakdirectory.h"
+
+// Checks the directory of a PAK file for records that point outside the
+// file or overlap each other, and checksums every entry.  The checksums can
+// be saved as a manifest and compared against on a later run.
+class PakVerifier
+{
+public:
+    explicit PakVerifier(const char *filename);
+
+    void setThreads(unsigned int threads); // 0 uses one thread per CPU.
+    int verify(); // Returns the number of problems found.
+    void writeManifest(const char *manifestFile);
+    int compareManifest(const char *manifestFile); // Returns the number of mismatches.
+    const stringList &problems() const;
+    const PakDirectory &directory() const;
+    const std::vector<uint32_t> &checksums() const;
+    int64_t bytesChecked() const;
+private:
+    std::string pakFile;
+    MappedFile pakData;
+    PakDirectory m_directory;
+    std::vector<bool> valid; // Whether each record lies within the file.
+    std::vector<uint32_t> m_checksums;
+    stringList m_problems;
+    unsigned int threadCount;
+    int64_t m_bytesChecked;
+
+    void checkDirectory();
+    void computeChecksums();
+    void addProblem(const PakRecord &record, const std::string &problem);
+};
+
+#endif // VERIFY_H
@@ -0,0 +1,151 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <memory>
+
+#include "extentcopy.h"
+#include "wadarchive.h"
+
+// Lump types of Quake's WAD2 files.
+const char WAD2_PALETTE = '@';
+const char WAD2_QPIC = 'B';
+const char WAD2_SOUND = 'C';
+const char WAD2_MIPTEX = 'D';
+// And of Half-Life's WAD3 files.
+const char WAD3_QPIC = 'B';
+const char WAD3_MIPTEX = 'C';
+const char WAD3_FONT = 'F';
+
+WadArchive::WadArchive() : m_size(0), wad3(false), count(0), tableOffset(0)
+{
+
+}
+
+bool WadArchive::isWad(const char *header, size_t length)
+{
+    return length >= WAD_HEADER_SIZE && (std::memcmp(header, "WAD2", 4) == 0 || std::memcmp(header, "WAD3", 4) == 0);
+}
+
+void WadArchive::checkHeader(const char *header, int64_t wadSize)
+{
+    if (wadSize < WAD_HEADER_SIZE || !isWad(header, wadSize)) {
+        throw (PakException("Invalid file", "Not a WAD2 or WAD3 file."));
+    }
+    wad3 = header[3] == '3';
+    std::memcpy(&count, header + 4, sizeof(int32_t));
+    std::memcpy(&tableOffset, header + 8, sizeof(int32_t));
+    m_size = wadSize;
+
+    if (count < 0 || tableOffset < WAD_HEADER_SIZE ||
+        static_cast<int64_t>(tableOffset) + static_cast<int64_t>(count) * WAD_LUMP_ENTRY_SIZE > wadSize) {
+        throw (PakException("File not valid", "WAD directory lies outside of the file.  File is truncated or corrupt."));
+    }
+}
+
+void WadArchive::parse(const char *table)
+{
+    m_lumps.clear();
+    m_lumps.resize(count);
+    for (auto &lump : m_lumps) {
+        std::memcpy(&lump.position, table, sizeof(int32_t));
+        std::memcpy(&lump.diskSize, table + 4, sizeof(int32_t));
+        std::memcpy(&lump.size, table + 8, sizeof(int32_t));
+        lump.type = table[12];
+        lump.compression = table[13];
+        const char *name = table + 16;
+        lump.name.assign(name, std::find(name, name + WAD_LUMP_NAME_SIZE, '\0'));
+        if (lump.diskSize < 0 || lump.position < 0 || static_cast<int64_t>(lump.position) + lump.diskSize > m_size) {
+            std::string message = lump.name;
+            message += " lies outside of the WAD file.";
+            throw PakException("File not valid", message.c_str());
+        }
+        table += WAD_LUMP_ENTRY_SIZE;
+    }
+}
+
+void WadArchive::load(const char *wadData, size_t wadSize)
+{
+    checkHeader(wadData, wadSize);
+    parse(wadData + tableOffset);
+}
+
+void WadArchive::load(int fd, int64_t offset, int64_t wadSize)
+{
+    char header[WAD_HEADER_SIZE];
+    if (wadSize < WAD_HEADER_SIZE) {
+        throw (PakException("Invalid file", "Not a WAD2 or WAD3 file."));
+    }
+    readAll(fd, header, WAD_HEADER_SIZE, offset);
+    checkHeader(header, wadSize);
+
+    std::unique_ptr<char[]> table(new char[size_t(count) * WAD_LUMP_ENTRY_SIZE]);
+    readAll(fd, table.get(), size_t(count) * WAD_LUMP_ENTRY_SIZE, offset + tableOffset);
+    parse(table.get());
+}
+
+size_t WadArchive::size() const
+{
+    return m_lumps.size();
+}
+
+const std::vector<WadLump> &WadArchive::lumps() const
+{
+    return m_lumps;
+}
+
+const WadLump *WadArchive::find(std::string_view name) const
+{
+    for (const auto &lump : m_lumps) {
+        if (lump.name.size() == name.size() &&
+            std::equal(name.begin(), name.end(), lump.name.begin(), [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            })) {
+            return &lump;
+        }
+    }
+    return nullptr;
+}
+
+fileTypes WadArchive::type(const WadLump &lump) const
+{
+    if (wad3) {
+        switch (lump.type) {
+        case WAD3_MIPTEX:
+            return fileTypes::Texture;
+        case WAD3_QPIC:
+        case WAD3_FONT:
+            return fileTypes::Graphic;
+        }
+        return fileTypes::Other;
+    }
+    switch (lump.type) {
+    case WAD2_MIPTEX:
+        return fileTypes::Texture;
+    case WAD2_QPIC:
+    case WAD2_PALETTE:
+        return fileTypes::Graphic;
+    case WAD2_SOUND:
+        return fileTypes::Sound;
+    }
+    return fileTypes::Other;
+}
@@ -0,0 +1,76 @@
+/*
+ * Utility to manipulate Quake PAK data files.
+ * Copyright (C) 2015  Dennis Katsonis <dennisk (at) netspace dot net dot au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef WADARCHIVE_H
+#define WADARCHIVE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "func.h"
+#include "pakexception.h"
+
+const int WAD_HEADER_SIZE = 12;
+const int WAD_LUMP_ENTRY_SIZE = 32;
+const int WAD_LUMP_NAME_SIZE = 16;
+
+// One lump from the directory of a WAD file.  Positions are from the
+// start of the WAD.
+struct WadLump
+{
+    std::string name;
+    int32_t position;
+    int32_t diskSize;
+    int32_t size; // Uncompressed size.
+    char type;
+    char compression;
+};
+
+// The directory of a Quake (WAD2) or Half-Life (WAD3) texture WAD, such as
+// gfx.wad, read from inside a PAK file without extracting it.  Either
+// parsed in place from a slice of a mapped PAK file, or read with ranged
+// reads of just the header and directory.
+class WadArchive
+{
+public:
+    WadArchive();
+
+    void load(const char *wadData, size_t wadSize); // Parse from an in memory (mapped) WAD.
+    void load(int fd, int64_t offset, int64_t wadSize); // Read the directory of a WAD at offset in a file.
+    size_t size() const;
+    const std::vector<WadLump> &lumps() const;
+    const WadLump *find(std::string_view name) const; // Names are compared ignoring case, as the engines do.  nullptr if not found.
+    fileTypes type(const WadLump &lump) const; // From the lump's type byte.
+    static bool isWad(const char *header, size_t length); // Whether the data starts with a WAD2 or WAD3 header.
+private:
+    int64_t m_size;
+    bool wad3;
+    std::vector<WadLump> m_lumps;
+
+    int32_t count; // Lumps in the directory.
+    int32_t tableOffset;
+
+    void checkHeader(const char *header, int64_t wadSize);
+    void parse(const char *table);
+};
+
+#endif // WADARCHIVE_H